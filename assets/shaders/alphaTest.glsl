@@ -0,0 +1,8 @@
+// Cutout of the model shaders. The shading and depth pre-pass fragment shaders have to discard exactly the same
+// fragments or the GL_EQUAL shading pass leaves holes, so the test only looks at the diffuse alpha.
+const float ALPHA_CUTOFF = 0.01;
+
+bool alphaClipped(float diffuseAlpha)
+{
+	return diffuseAlpha < ALPHA_CUTOFF;
+}
\ No newline at end of file
@@ -0,0 +1,5 @@
+#version 330 core
+// depth pre-pass of opaque geometry without alpha testing, color writes are masked off
+void main()
+{
+}
\ No newline at end of file
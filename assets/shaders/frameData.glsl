@@ -0,0 +1,10 @@
+// Per-frame camera and light data, filled once per frame by FrameData::Update.
+// Layout is std140 and has to match FrameData::Block on the CPU side.
+layout(std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	vec3 cameraPosition;
+	float time;
+	vec3 lightDirection;
+};
\ No newline at end of file
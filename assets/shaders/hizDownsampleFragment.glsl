@@ -0,0 +1,37 @@
+#version 330 core
+out float depth;
+
+// level to reduce, the pyramid restricts its base level to it while the next one is rendered
+uniform sampler2D source;
+
+float fetch(ivec2 texel, ivec2 size)
+{
+	return texelFetch(source, min(texel, size - 1), 0).r;
+}
+
+void main()
+{
+	ivec2 size = textureSize(source, 0);
+	ivec2 texel = ivec2(gl_FragCoord.xy) * 2;
+
+	// farthest depth of the 2x2 footprint, odd sizes fold their last row or column into the neighbouring texel
+	float farthest = max(max(fetch(texel, size), fetch(texel + ivec2(1, 0), size)),
+		max(fetch(texel + ivec2(0, 1), size), fetch(texel + ivec2(1, 1), size)));
+
+	bool extraColumn = (size.x & 1) != 0 && texel.x + 3 == size.x;
+	bool extraRow = (size.y & 1) != 0 && texel.y + 3 == size.y;
+	if (extraColumn)
+	{
+		farthest = max(farthest, max(fetch(texel + ivec2(2, 0), size), fetch(texel + ivec2(2, 1), size)));
+	}
+	if (extraRow)
+	{
+		farthest = max(farthest, max(fetch(texel + ivec2(0, 2), size), fetch(texel + ivec2(1, 2), size)));
+	}
+	if (extraColumn && extraRow)
+	{
+		farthest = max(farthest, fetch(texel + ivec2(2, 2), size));
+	}
+
+	depth = farthest;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#version 330 core
+#include "frameData.glsl"
+layout(location = 0) in vec3 boxMin;
+layout(location = 1) in vec3 boxMax;
+
+// farthest depth pyramid, level 0 is half the screen resolution
+uniform sampler2D pyramid;
+uniform int levelCount;
+
+// captured with transform feedback, 1 when the box may be visible
+out float visible;
+
+void main()
+{
+	mat4 viewProjection = projection * view;
+
+	vec2 rectMin = vec2(1.0);
+	vec2 rectMax = vec2(0.0);
+	float nearest = 1.0;
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = vec3((i & 1) != 0 ? boxMax.x : boxMin.x, (i & 2) != 0 ? boxMax.y : boxMin.y, (i & 4) != 0 ? boxMax.z : boxMin.z);
+		vec4 clip = viewProjection * vec4(corner, 1.0);
+		// a box reaching behind the camera can not be projected, keep it
+		if (clip.w <= 0.0)
+		{
+			visible = 1.0;
+			return;
+		}
+
+		vec3 ndc = clip.xyz / clip.w;
+		rectMin = min(rectMin, ndc.xy * 0.5 + 0.5);
+		rectMax = max(rectMax, ndc.xy * 0.5 + 0.5);
+		nearest = min(nearest, ndc.z * 0.5 + 0.5);
+	}
+	rectMin = clamp(rectMin, 0.0, 1.0);
+	rectMax = clamp(rectMax, 0.0, 1.0);
+
+	// the level where the rectangle spans at most two texels, so four fetches cover it
+	vec2 extent = (rectMax - rectMin) * vec2(textureSize(pyramid, 0));
+	int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, levelCount - 1);
+
+	ivec2 size = textureSize(pyramid, level);
+	ivec2 low = clamp(ivec2(rectMin * vec2(size)), ivec2(0), size - 1);
+	ivec2 high = clamp(ivec2(rectMax * vec2(size)), ivec2(0), size - 1);
+
+	float farthest = max(max(texelFetch(pyramid, low, level).r, texelFetch(pyramid, ivec2(high.x, low.y), level).r),
+		max(texelFetch(pyramid, ivec2(low.x, high.y), level).r, texelFetch(pyramid, high, level).r));
+
+	visible = nearest <= farthest ? 1.0 : 0.0;
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 330 core
+#include "alphaTest.glsl"
+in vec2 TexCoords;
+
+uniform sampler2D texture_diffuse1;
+
+void main()
+{
+    if (alphaClipped(texture(texture_diffuse1, TexCoords).a)) {
+        discard;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 330 core
+#include "frameData.glsl"
+// position only version of modelVertex.glsl plus the uvs the alpha test needs
+layout(location = 0) in vec3 aPos;
+layout(location = 2) in vec2 aTexCoords;
+layout(location = 7) in mat4 instanceTransform;
+
+out vec2 TexCoords;
+
+invariant gl_Position;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    vec4 FragPos = instanceTransform * vec4(aPos, 1.0);
+    gl_Position = projection * view * FragPos;
+}
\ No newline at end of file
@@ -1,4 +1,6 @@
 #version 330 core
+#include "frameData.glsl"
+#include "alphaTest.glsl"
 out vec4 FragColor;
 
 in vec2 TexCoords;
@@ -11,9 +13,6 @@ uniform sampler2D texture_normal1;
 uniform sampler2D texture_roughness1;
 uniform sampler2D texture_ao1;
 
-uniform vec3 cameraPosition;
-uniform vec3 lightDirection;
-
 float lerp(float a, float b, float t) {
     return a + (b - a) * t;
 }
@@ -31,6 +30,10 @@ vec4 lerp(vec4 a, vec4 b, float t)
 void main()
 {
     vec4 diffuse = texture(texture_diffuse1, TexCoords);
+    // the same cutout as the depth pre-pass
+    if (alphaClipped(diffuse.a)) {
+        discard;
+    }
     vec4 specTex = texture(texture_specular1, TexCoords);
 
     float light = max(dot(-lightDirection, Normals), 0.0);
@@ -60,12 +63,5 @@ void main()
 
     float fog = pow(clamp((dist - 2500) / 1000, 0, 1), 1.5);
     
-    vec4 tmpOutput = lerp(finalColor, vec4(fogColor, 1.0), fog);
-    
-    //Clip at threshold
-    if(tmpOutput.a < 0.01) {
-        discard;
-    }
-
-    FragColor = tmpOutput;
+    FragColor = lerp(finalColor, vec4(fogColor, 1.0), fog);
 }
\ No newline at end of file
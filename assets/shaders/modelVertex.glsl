@@ -1,22 +1,33 @@
 #version 330 core
+#include "frameData.glsl"
+// PackedVertex: quantized position (0..1 inside the model cube), tangent frame quaternion, half float uvs
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aNormal;
+layout(location = 1) in vec4 aQTangent;
 layout(location = 2) in vec2 aTexCoords;
+// per instance, filled by RenderQueue (locations 7 to 10), already includes the dequantization
+layout(location = 7) in mat4 instanceTransform;
 
 out vec2 TexCoords;
 out vec3 Normals;
 out vec4 FragPos;
 
-uniform mat4 transform;
-uniform mat4 view;
-uniform mat4 projection;
+// has to match modelDepthVertex.glsl exactly for the GL_EQUAL pass after the depth pre-pass
+invariant gl_Position;
+
+vec3 quatRotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
 
 void main()
 {
     TexCoords = aTexCoords;
-    FragPos = transform * vec4(aPos, 1.0);
+    FragPos = instanceTransform * vec4(aPos, 1.0);
     gl_Position = projection * view * FragPos;
 
+    // the frame's z axis is the normal, the sign of w only matters for the bitangent
+    vec3 normal = quatRotate(normalize(aQTangent), vec3(0.0, 0.0, 1.0));
+
     // not the most efficient, but it works
-    Normals = normalize( mat3(inverse(transpose(transform)))* aNormal );
+    Normals = normalize( mat3(inverse(transpose(instanceTransform)))* normal );
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #version 330 core
+#include "frameData.glsl"
 out vec4 FragColor;
 
 in vec3 vertexColor;
@@ -10,14 +11,13 @@ in vec3 worldPosition;
 uniform sampler2D mainTex;
 uniform sampler2D normalTex;
 uniform vec3 lightPosition;
-uniform vec3 cameraPosition;
 
 uniform vec3 ambientLightColor;
 uniform float ambientLightIntensity;
 
 void main()
 {
-	vec3 lightDirection = normalize(lightPosition - worldPosition);
+	vec3 pointLightDirection = normalize(lightPosition - worldPosition);
 
 	vec3 normalMapNormal = texture(normalTex, uv).rgb;
 	normalMapNormal = normalize(normalMapNormal * 2.0 - 1.0);
@@ -31,11 +31,11 @@ void main()
 
 	// Specular Data
 	vec3 viewDirection = normalize(worldPosition - cameraPosition);
-	vec3 reflectedLight = normalize(reflect(lightDirection, normalMapNormal));
+	vec3 reflectedLight = normalize(reflect(pointLightDirection, normalMapNormal));
 	float phongSpecular = pow(max(dot(reflectedLight, normalize(viewDirection)), 1.0), 128); // higher power = smaller highlight
 
 	// Lighting
-	float lightValue = max(dot(normalMapNormal, lightDirection), 0.0); // Simple Diffuse Lighting
+	float lightValue = max(dot(normalMapNormal, pointLightDirection), 0.0); // Simple Diffuse Lighting
 	vec3 ambientLight = ambientLightColor * ambientLightIntensity; // Ambient
 
 	vec4 colorOutput = vec4(vertexColor, 1.0) * texture(mainTex, uv);
@@ -1,4 +1,5 @@
 #version 330 core
+#include "frameData.glsl"
 layout(location = 0) in vec3 vPos;
 layout(location = 1) in vec3 vColor;
 layout(location = 2) in vec2 vUv;
@@ -7,9 +8,6 @@ layout(location = 4) in vec3 vTangent;
 layout(location = 5) in vec3 vBitangent;
 
 uniform mat4 transform;
-uniform mat4 view;
-uniform mat4 projection;
-uniform float time;
 
 out vec3 vertexColor;
 out vec2 uv;
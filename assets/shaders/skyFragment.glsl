@@ -1,9 +1,7 @@
 #version 330 core
+#include "frameData.glsl"
 out vec4 FragColor;
 
-uniform vec3 lightDirection;
-uniform vec3 cameraPosition;
-
 in vec3 worldPosition;
 
 vec3 lerp(vec3 a, vec3 b, float t)
@@ -1,9 +1,8 @@
 #version 330 core
+#include "frameData.glsl"
 layout(location = 0) in vec3 vPos;
 
 uniform mat4 transform;
-uniform mat4 view;
-uniform mat4 projection;
 
 out vec3 worldPosition;
 
@@ -0,0 +1,13 @@
+#version 330 core
+#include "frameData.glsl"
+#include "terrainPosition.glsl"
+layout(location = 0) in vec3 vPos;
+layout(location = 2) in vec2 vUv;
+
+invariant gl_Position;
+
+void main()
+{
+	vec3 worldPosition = terrainWorldPosition(vPos, vUv);
+	gl_Position = projection * view * vec4(worldPosition, 1.0);
+}
\ No newline at end of file
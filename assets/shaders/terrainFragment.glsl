@@ -1,4 +1,5 @@
 #version 330 core
+#include "frameData.glsl"
 
 // Noise Methods: https://gist.github.com/patriciogonzalezvivo/670c22f3966e662d2f83
 vec4 permute(vec4 x){return mod(((x*34.0)+1.0)*x, 289.0);}
@@ -48,14 +49,13 @@ in vec3 worldPosition;
 uniform sampler2D mainTex;
 uniform sampler2D normalTex;
 
-uniform sampler2D dirtTex;
-uniform sampler2D grassTex;
-uniform sampler2D rockTex;
-uniform sampler2D snowTex;
-uniform sampler2D sandTex;
-
-uniform vec3 lightDirection;
-uniform vec3 cameraPosition;
+// splat textures, keep the layer numbers in sync with Terrain::SplatLayer
+uniform sampler2DArray splatLayers;
+const int DIRT_LAYER = 0;
+const int SAND_LAYER = 1;
+const int GRASS_LAYER = 2;
+const int ROCK_LAYER = 3;
+const int SNOW_LAYER = 4;
 
 vec3 lerp(vec3 a, vec3 b, float t)
 {
@@ -75,20 +75,28 @@ float roundedCornerLerp(float value, float blendFactor, float blendPower)
     return 1.0 - pow(1.0 - pow(value, blendFactor), blendPower);
 }
 
-vec3 colorFromNormalWithLerp(vec3 normal, float slopeCutoff, vec3 color1, vec3 color2, float slopeBlendPower, float slopeBlendFactor)
+float slopeBlendFromNormal(vec3 normal, float slopeCutoff, float slopeBlendPower, float slopeBlendFactor)
 {
     float value = (dot(normal, vec3(0,1,0)) - slopeCutoff + 1) / 2;
     value = roundedCornerLerp(value,slopeBlendFactor, slopeBlendPower);
 
-    value = clamp(value, 0.0, 1.0);
+    return clamp(value, 0.0, 1.0);
+}
 
-    return mix(color1, color2, value);
+// layers without weight are skipped, the gradients come from outside the branch so the mip selection stays defined
+vec3 addLayer(vec3 color, int layerIndex, float weight, vec2 layerUv, vec2 uvDx, vec2 uvDy)
+{
+    if (weight <= 0.0) {
+        return color;
+    }
+    return color + textureGrad(splatLayers, vec3(layerUv, layerIndex), uvDx, uvDy).rgb * weight;
 }
 
 void main()
 {
-	vec3 normalMapNormal = texture(normalTex, uv).rgb;
-	normalMapNormal = normalize(normalMapNormal * 2.0 - 1.0);
+	// the normal map is BC5, only x and y are stored and z (up on a heightfield) is rebuilt from them
+	vec2 normalMapXY = texture(normalTex, uv).rg * 2.0 - 1.0;
+	vec3 normalMapNormal = vec3(normalMapXY, sqrt(max(1.0 - dot(normalMapXY, normalMapXY), 0.0)));
 	normalMapNormal.gb = normalMapNormal.bg;
 	normalMapNormal.g = -normalMapNormal.g;
 
@@ -104,17 +112,25 @@ void main()
     float dist = distance(worldPosition, cameraPosition);
 
     float uvScale = 10;
-    vec3 dirtColor = texture(dirtTex, uv * uvScale).rgb;
-    vec3 sandColor = texture(sandTex, uv * uvScale).rgb;
-    vec3 grassColor = texture(grassTex, uv * uvScale).rgb;
-    vec3 rockColor = texture(rockTex, uv * uvScale).rgb;
-    vec3 snowColor = texture(snowTex, uv * uvScale).rgb;
-
-    vec3 diffuse = lerp(dirtColor, sandColor, dirtToSand);
-    diffuse = lerp(diffuse, grassColor, sandToGrass);
-    diffuse = lerp(diffuse, snowColor, grassToSnow);
-
-    diffuse = colorFromNormalWithLerp(normalMapNormal, 0.4, diffuse, rockColor, 60, 4);
+    vec2 layerUv = uv * uvScale;
+    vec2 uvDx = dFdx(layerUv);
+    vec2 uvDy = dFdy(layerUv);
+
+    // the height bands blend dirt -> sand -> grass -> snow and steep slopes blend that towards rock,
+    // written out as one weight per layer
+    float rockWeight = slopeBlendFromNormal(normalMapNormal, 0.4, 60, 4);
+    float bandWeight = 1.0 - rockWeight;
+    float snowWeight = grassToSnow * bandWeight;
+    float grassWeight = sandToGrass * (1.0 - grassToSnow) * bandWeight;
+    float sandWeight = dirtToSand * (1.0 - sandToGrass) * (1.0 - grassToSnow) * bandWeight;
+    float dirtWeight = (1.0 - dirtToSand) * (1.0 - sandToGrass) * (1.0 - grassToSnow) * bandWeight;
+
+    vec3 diffuse = vec3(0.0);
+    diffuse = addLayer(diffuse, DIRT_LAYER, dirtWeight, layerUv, uvDx, uvDy);
+    diffuse = addLayer(diffuse, SAND_LAYER, sandWeight, layerUv, uvDx, uvDy);
+    diffuse = addLayer(diffuse, GRASS_LAYER, grassWeight, layerUv, uvDx, uvDy);
+    diffuse = addLayer(diffuse, ROCK_LAYER, rockWeight, layerUv, uvDx, uvDy);
+    diffuse = addLayer(diffuse, SNOW_LAYER, snowWeight, layerUv, uvDx, uvDy);
 
 
     // Construct Color
@@ -0,0 +1,14 @@
+// Displaced terrain position, shared by the shading and depth pre-pass vertex shaders. Both declare
+// gl_Position invariant, so the pre-pass depth is bit for bit what the GL_EQUAL shading pass compares against.
+uniform mat4 transform;
+
+uniform sampler2D mainTex;
+
+vec3 terrainWorldPosition(vec3 position, vec2 texCoords)
+{
+	vec3 worldPosition = vec3(transform * vec4(position, 1.0));
+
+	// keep in sync with Terrain::SHADER_HEIGHT_SCALE
+	worldPosition.y += texture(mainTex, texCoords).r * 300.0;
+	return worldPosition;
+}
\ No newline at end of file
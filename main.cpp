@@ -1,4 +1,6 @@
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
@@ -7,6 +9,8 @@
 
 #include "src/core/Input.hpp"
 #include "src/core/Time.hpp"
+#include "src/core/Profiler.hpp"
+#include "src/core/InputRecorder.hpp"
 #include "src/Objects/IUpdate.hpp"
 #include "src/Objects/Camera.hpp"
 #include "src/Objects/RenderObject.hpp"
@@ -14,18 +18,39 @@
 #include "src/rendering/model.hpp"
 #include "src/core/Debug.hpp"
 #include "src/rendering/SkyBox.hpp"
+#include "src/rendering/Framebuffer.hpp"
+#include "src/rendering/GpuProfiler.hpp"
+#include "src/rendering/GLState.hpp"
+#include "src/rendering/Terrain.hpp"
+#include "src/rendering/FrameData.hpp"
+#include "src/rendering/RenderQueue.hpp"
+#include "src/rendering/GeometryArena.hpp"
+#include "src/rendering/SceneCuller.hpp"
+#include "src/rendering/HiZBuffer.hpp"
+#include "src/rendering/OcclusionRasterizer.hpp"
+#include "src/rendering/MeshOptimizer.hpp"
+#include "src/rendering/MeshCache.hpp"
+#include "src/rendering/RenderGraph.hpp"
+#include "src/rendering/TextureCache.hpp"
+#include "src/rendering/TextureStreamer.hpp"
+#include "src/rendering/TextureRegistry.hpp"
+#include "src/core/ThreadPool.hpp"
 
 using Clock = std::chrono::high_resolution_clock;
 using TimePoint = std::chrono::time_point<Clock>;
 using FloatDuration = std::chrono::duration<float>;
 
 // Forward Declare
+void parseArguments(int argc, char** argv);
 int init(GLFWwindow*& window);
-void updateFrameTime(TimePoint& frameStart);
+void updateFrameTime();
 void setup();
 void process();
 void draw();
-void addRenderObject(Model* model, Material* material, glm::vec3 position = glm::vec3(0, 0, 0));
+void buildFrameGraph(SkyBox* skyBox, Terrain* terrain);
+void addRenderObject(Model* model, Material* material, glm::vec3 position = glm::vec3(0, 0, 0), glm::vec3 scale = glm::vec3(1, 1, 1));
+void printThroughput(float setupTime, float runTime);
+void runLoadBenchmark();
 
 // Variables
 unsigned int frames = 0;
@@ -33,25 +58,91 @@ int frameRate = 120;
 float wantedFrameTime = 1.0f / (float)frameRate;
 float deltaTime = wantedFrameTime;
 
+// Run Options
+bool headless = false;
+unsigned int benchmarkFrames = 0;
+bool printProfile = false;
+const char* profileCSVPath = nullptr;
+bool gpuStatistics = false;
+HiZBuffer::Mode occlusionMode = HiZBuffer::GPU;
+bool softwareOcclusion = false;
+bool terrainPrepass = false;
+bool modelPrepass = false;
+bool streamTextures = true;
+bool loadBenchmark = false;
+const char* recordPath = nullptr;
+const char* replayPath = nullptr;
+Framebuffer* offscreenTarget = nullptr;
+
 std::vector<IUpdate*> updateables;
 std::vector<RenderObject*> renderObjects;
+RenderQueue renderQueue;
+SceneCuller sceneCuller;
+HiZBuffer hiZBuffer;
+ThreadPool* workerPool = nullptr;
+OcclusionRasterizer* occlusionRasterizer = nullptr;
+RenderGraph* frameGraph = nullptr;
 
 Model* treeModel;
 Material* baseModelMaterial;
+Terrain* terrain = nullptr;
 
-int main()
+int main(int argc, char** argv)
 {
+	parseArguments(argc, argv);
+
 	GLFWwindow* window;
 	int result = init(window);
 	if (result != 0) { return result; }
 
+	GpuProfiler::Init(gpuStatistics);
+
+	if (replayPath != nullptr && !InputRecorder::StartReplay(replayPath)) { return -4; }
+	if (recordPath != nullptr && !InputRecorder::StartRecording(recordPath)) { return -4; }
+
+	// after every early return, the decode threads have to be joined by Shutdown
+	if (streamTextures) { TextureStreamer::Init(); }
+
+	if (loadBenchmark)
+	{
+		runLoadBenchmark();
+		TextureStreamer::Shutdown();
+		glfwTerminate();
+		return 0;
+	}
+
+	if (headless)
+	{
+		offscreenTarget = new Framebuffer(SCREEN_WIDTH, SCREEN_HEIGHT);
+		offscreenTarget->Bind();
+	}
+
+	TimePoint setupStart = Clock::now();
 	setup();
+	FloatDuration setupTime = Clock::now() - setupStart;
+
+	// a measured run starts with every texture resident, frames sampling placeholders would flatter the numbers
+	TimePoint streamStart = Clock::now();
+	if (headless || benchmarkFrames != 0)
+	{
+		while (TextureStreamer::Pending() != 0)
+		{
+			TextureStreamer::Update();
+			// the fences only signal once the commands before them are submitted
+			glFlush();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	FloatDuration streamTime = Clock::now() - streamStart;
 
 	Time::deltaTime = wantedFrameTime;
 
+	TimePoint runStart = Clock::now();
 	while (!glfwWindowShouldClose(window))
 	{
-		TimePoint frameStart = Clock::now();
+		Profiler::BeginFrame();
+		GpuProfiler::BeginFrame();
+		InputRecorder::BeginFrame();
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -60,33 +151,221 @@ int main()
 			glfwSetWindowShouldClose(window, true);
 		}
 
-		process();
-		draw();
+		TextureStreamer::Update();
+
+		{
+			PROFILE_SCOPE("process");
+			process();
+		}
+		{
+			PROFILE_SCOPE("draw");
+			draw();
+		}
+
+		if (!headless)
+		{
+			PROFILE_SCOPE("swap");
+			glfwSwapBuffers(window);
+		}
+		{
+			PROFILE_SCOPE("events");
+			glfwPollEvents();
+		}
+		GLState::EndFrame();
+		updateFrameTime();
+
+		if ((benchmarkFrames != 0 && frames >= benchmarkFrames) || InputRecorder::ReplayFinished())
+		{
+			glfwSetWindowShouldClose(window, true);
+		}
+	}
+
+	InputRecorder::Stop();
+
+	// make sure all queued GPU work is part of the measurement
+	glFinish();
+	FloatDuration runTime = Clock::now() - runStart;
+
+	if (headless || benchmarkFrames != 0)
+	{
+		if (streamTextures)
+		{
+			std::cout << "Textures: streamed in before the measured run, waited " << streamTime.count() * 1000.0f << " ms" << std::endl;
+		}
+		else
+		{
+			std::cout << "Textures: loaded synchronously during setup" << std::endl;
+		}
+		printThroughput(setupTime.count(), runTime.count());
+	}
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-		updateFrameTime(frameStart);
+	if (printProfile || headless || benchmarkFrames != 0)
+	{
+		Profiler::Report(std::cout);
+		GeometryArena::Report(std::cout);
+		MeshOptimizer::Report(std::cout);
+		MeshCache::Report(std::cout);
+		TextureCache::Report(std::cout);
+		TextureStreamer::Report(std::cout);
+		TextureRegistry::Report(std::cout);
+		frameGraph->Report(std::cout);
+	}
+	if (profileCSVPath != nullptr && !Profiler::WriteCSV(profileCSVPath))
+	{
+		std::cout << "Failed to write profile to " << profileCSVPath << std::endl;
 	}
 
+	delete frameGraph;
+	delete treeModel;
+	delete baseModelMaterial;
+	delete terrain;
+	TextureStreamer::Shutdown();
+	delete occlusionRasterizer;
+	delete workerPool;
+	delete offscreenTarget;
+	glfwTerminate();
 	return 0;
 }
 
+void parseArguments(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			benchmarkFrames = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--profile") == 0)
+		{
+			printProfile = true;
+		}
+		else if (std::strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc)
+		{
+			profileCSVPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--gpu-stats") == 0)
+		{
+			gpuStatistics = true;
+		}
+		else if (std::strcmp(argv[i], "--no-occlusion") == 0)
+		{
+			occlusionMode = HiZBuffer::DISABLED;
+		}
+		else if (std::strcmp(argv[i], "--cpu-occlusion") == 0)
+		{
+			occlusionMode = HiZBuffer::CPU;
+		}
+		else if (std::strcmp(argv[i], "--soft-occlusion") == 0)
+		{
+			softwareOcclusion = true;
+		}
+		else if (std::strcmp(argv[i], "--terrain-prepass") == 0)
+		{
+			terrainPrepass = true;
+		}
+		else if (std::strcmp(argv[i], "--model-prepass") == 0)
+		{
+			modelPrepass = true;
+		}
+		else if (std::strcmp(argv[i], "--prepass") == 0)
+		{
+			terrainPrepass = true;
+			modelPrepass = true;
+		}
+		else if (std::strcmp(argv[i], "--no-mesh-opt") == 0)
+		{
+			MeshOptimizer::SetEnabled(false);
+		}
+		else if (std::strcmp(argv[i], "--no-mesh-cache") == 0)
+		{
+			MeshCache::SetEnabled(false);
+		}
+		else if (std::strcmp(argv[i], "--load-benchmark") == 0)
+		{
+			loadBenchmark = true;
+		}
+		else if (std::strcmp(argv[i], "--no-texture-compression") == 0)
+		{
+			TextureCache::SetCompression(false);
+		}
+		else if (std::strcmp(argv[i], "--sync-textures") == 0)
+		{
+			streamTextures = false;
+		}
+		else if (std::strcmp(argv[i], "--upload-budget") == 0 && i + 1 < argc)
+		{
+			TextureStreamer::SetUploadBudget((size_t)std::strtoul(argv[++i], nullptr, 10) * 1024);
+		}
+		else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+		{
+			recordPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+		{
+			replayPath = argv[++i];
+		}
+		else
+		{
+			std::cout << "Unknown argument: " << argv[i] << std::endl;
+		}
+	}
+
+	// a headless run has nobody to close the window, so it renders a fixed amount of frames or until the replay ends
+	if (headless && benchmarkFrames == 0 && replayPath == nullptr)
+	{
+		benchmarkFrames = 1000;
+	}
+}
+
 void setup()
 {
 	SkyBox* skyBox = new SkyBox();
-	updateables.push_back(skyBox);
 
+	// the camera is updated by process itself, before anything that reads the frame data
 	Camera::init(glm::normalize(glm::vec3(0.0f, -0.5f, -0.5f)), glm::vec3(100.0f, 125.0f, 100.0f));
-	updateables.push_back(Camera::Instance());
+	FrameData::Init();
+	renderQueue.Init();
+	renderQueue.SetDepthPrepass(modelPrepass);
+	hiZBuffer.Init(softwareOcclusion ? HiZBuffer::DISABLED : occlusionMode);
+	sceneCuller.SetOcclusion(hiZBuffer.GetMode() != HiZBuffer::DISABLED ? &hiZBuffer : nullptr);
+
+	terrain = new Terrain("assets/textures/Heightmap2.png", 100.0f, 5.0f);
+	terrain->SetDepthPrepass(terrainPrepass);
+
+	// the software rasterizer replaces the depth pyramid, a coarse copy of the terrain is its only occluder
+	if (softwareOcclusion)
+	{
+		workerPool = new ThreadPool();
+		occlusionRasterizer = new OcclusionRasterizer(*workerPool);
+
+		std::vector<glm::vec3> occluderPositions;
+		std::vector<unsigned int> occluderIndices;
+		terrain->BuildOccluder(4, occluderPositions, occluderIndices);
+		occlusionRasterizer->AddOccluder(occluderPositions, occluderIndices);
+		sceneCuller.SetOcclusion(occlusionRasterizer);
+	}
+
 	treeModel = new Model("assets/models/tree/tree.obj");
 	baseModelMaterial = new Material("assets/shaders/modelVertex.glsl", "assets/shaders/modelFragment.glsl");
 
-	addRenderObject(treeModel, baseModelMaterial);
-	addRenderObject(treeModel, baseModelMaterial, glm::vec3(0, 0, 5));
+	// forest on the grass band of the terrain, the render queue draws all trees of a mesh in one instanced call
+	for (const glm::vec3& position : terrain->ScatterPositions(0.01f, 100.0f, 200.0f))
+	{
+		addRenderObject(treeModel, baseModelMaterial, position, glm::vec3(10, 10, 10));
+	}
+
+	buildFrameGraph(skyBox, terrain);
 }
 
 void process() 
 {
+	Camera::Instance()->Update();
+	FrameData::Update(*Camera::Instance(), Time::time);
+
 	for (IUpdate* obj : updateables) 
 	{
 		if (obj)
@@ -98,30 +377,97 @@ void process()
 
 void draw()
 {
-	for (RenderObject* obj : renderObjects)
-	{
-		if (obj)
+	frameGraph->Execute();
+}
+
+void buildFrameGraph(SkyBox* skyBox, Terrain* terrain)
+{
+	frameGraph = new RenderGraph();
+
+	GLuint target = offscreenTarget ? offscreenTarget->fbo : 0;
+	RenderGraph::Resource color = frameGraph->ImportTarget("scene color", target, SCREEN_WIDTH, SCREEN_HEIGHT);
+	RenderGraph::Resource depth = frameGraph->ImportTarget("scene depth", target, SCREEN_WIDTH, SCREEN_HEIGHT);
+	RenderGraph::Resource depthPyramid = frameGraph->CreateData("depth pyramid");
+	RenderGraph::Resource occluderDepth = frameGraph->CreateData("occluder depth");
+	RenderGraph::Resource visibleSet = frameGraph->CreateData("visible set");
+
+	frameGraph->AddPass("sky",
+		[&](RenderGraph::Builder& builder) { color = builder.Write(color); },
+		[skyBox]() { skyBox->Draw(); });
+
+	frameGraph->AddPass("terrain",
+		[&](RenderGraph::Builder& builder)
 		{
-			obj->DrawObject();
-		}
-	}
+			color = builder.Write(color);
+			depth = builder.Write(depth);
+		},
+		[terrain]() { terrain->Draw(); });
+
+	// the terrain is the occluder for the models, both occlusion passes only run when culling reads them
+	frameGraph->AddPass("hiz build",
+		[&](RenderGraph::Builder& builder)
+		{
+			builder.Read(depth);
+			depthPyramid = builder.Write(depthPyramid);
+		},
+		[target]()
+		{
+			Camera* camera = Camera::Instance();
+			hiZBuffer.Build(target, SCREEN_WIDTH, SCREEN_HEIGHT, camera->projection * camera->view);
+		});
+
+	frameGraph->AddPass("occlusion raster",
+		[&](RenderGraph::Builder& builder) { occluderDepth = builder.Write(occluderDepth); },
+		[]()
+		{
+			Camera* camera = Camera::Instance();
+			occlusionRasterizer->Render(camera->projection * camera->view);
+		});
+
+	frameGraph->AddPass("cull",
+		[&](RenderGraph::Builder& builder)
+		{
+			if (hiZBuffer.GetMode() != HiZBuffer::DISABLED) { builder.Read(depthPyramid); }
+			if (occlusionRasterizer) { builder.Read(occluderDepth); }
+			visibleSet = builder.Write(visibleSet);
+		},
+		[]()
+		{
+			GPU_PASS_SCOPE("cull");
+			Camera* camera = Camera::Instance();
+			glm::mat4 viewProjection = camera->projection * camera->view;
+			renderQueue.Begin(camera->position);
+			sceneCuller.Cull(Frustum::FromMatrix(viewProjection), camera->position, camera->projection[1][1] * SCREEN_HEIGHT * 0.5f, renderQueue);
+		});
+
+	// the queue times its depth pre-pass and shading pass as separate GPU passes
+	frameGraph->AddPass("models",
+		[&](RenderGraph::Builder& builder)
+		{
+			builder.Read(visibleSet);
+			color = builder.Write(color);
+			depth = builder.Write(depth);
+		},
+		[]() { renderQueue.Execute(); });
+
+	frameGraph->Compile();
 }
 
-void addRenderObject(Model* model, Material* material, glm::vec3 position)
+void addRenderObject(Model* model, Material* material, glm::vec3 position, glm::vec3 scale)
 {
-	RenderObject* treeObject = new RenderObject(model, material, position);
+	RenderObject* treeObject = new RenderObject(model, material, position, glm::quat(glm::vec3(0, 0, 0)), scale);
 	updateables.push_back(treeObject);
 	renderObjects.push_back(treeObject);
+	sceneCuller.Add(treeObject);
 }
 
-void updateFrameTime(TimePoint& frameStart)
+void updateFrameTime()
 {
-	TimePoint frameEnd = Clock::now();
-	FloatDuration elapsed = frameEnd - frameStart;
-	deltaTime = elapsed.count();  // deltaTime in seconds
+	deltaTime = Profiler::EndFrame();  // deltaTime in seconds
 
+	// benchmark runs are uncapped, we want to know how fast a frame can go
 	float waitTime = wantedFrameTime - deltaTime;
-	if (waitTime > 0.0f) {
+	if (waitTime > 0.0f && !headless && benchmarkFrames == 0) {
 		std::this_thread::sleep_for(FloatDuration(waitTime));
 	}
 
@@ -129,15 +475,87 @@ void updateFrameTime(TimePoint& frameStart)
 	frames++;
 }
 
+void printThroughput(float setupTime, float runTime)
+{
+	std::cout << "Setup: " << setupTime * 1000.0f << " ms" << std::endl;
+	// a replay that ends right away or a window closed on the first frame would divide by zero
+	if (frames == 0 || runTime <= 0.0f)
+	{
+		std::cout << "Frames: none ran, no throughput to report" << std::endl;
+		return;
+	}
+	std::cout << "Frames: " << frames << " in " << runTime << " s" << std::endl;
+	std::cout << "Throughput: " << frames / runTime << " frames/s, " << (runTime * 1000.0f) / frames << " ms/frame" << std::endl;
+}
+
+void runLoadBenchmark()
+{
+	const char* paths[] = { "assets/models/tree/tree.obj", "assets/models/uv_sphere.obj" };
+	const int runs = 5;
+	bool cacheEnabled = MeshCache::Enabled();
+
+	for (const char* path : paths)
+	{
+		// the first load writes the cache file and keeps the textures acquired, so the timed loads only measure geometry
+		MeshCache::SetEnabled(true);
+		Model* primed = new Model(path);
+
+		float timings[2] = { 0.0f, 0.0f };
+		for (int run = 0; run < runs; run++)
+		{
+			for (int cached = 0; cached < 2; cached++)
+			{
+				MeshCache::SetEnabled(cached == 1);
+				TimePoint start = Clock::now();
+				Model* model = new Model(path);
+				glFinish();
+				timings[cached] += FloatDuration(Clock::now() - start).count();
+				delete model;
+			}
+		}
+
+		delete primed;
+		std::cout << "Load " << path << ": import " << timings[0] * 1000.0f / runs << " ms, mesh cache "
+			<< timings[1] * 1000.0f / runs << " ms (" << timings[0] / timings[1] << "x)" << std::endl;
+	}
+
+	MeshCache::SetEnabled(cacheEnabled);
+}
+
 int init(GLFWwindow*& window)
 {
-	glfwInit();
+#if defined(GLFW_PLATFORM_NULL) && !defined(_WIN32)
+	// without a display server fall back to GLFW's null platform, which renders through an OSMesa context
+	bool hasDisplay = std::getenv("DISPLAY") != nullptr || std::getenv("WAYLAND_DISPLAY") != nullptr;
+	if (headless && !hasDisplay && glfwPlatformSupported(GLFW_PLATFORM_NULL))
+	{
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	}
+#endif
+
+	if (!glfwInit())
+	{
+		std::cout << "Failed to initialize GLFW" << std::endl;
+		return -3;
+	}
 
 	// Tell GLFW which profile & openGL version we're using
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 
+	if (headless)
+	{
+		// the window only exists to own the context, everything is rendered into an offscreen framebuffer
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#if defined(GLFW_PLATFORM_NULL)
+		if (glfwGetPlatform() == GLFW_PLATFORM_NULL)
+		{
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+		}
+#endif
+	}
+
 	// Create Window
 	window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Rendering Window", nullptr, nullptr);
 	if (window == nullptr)
@@ -150,7 +568,10 @@ int init(GLFWwindow*& window)
 	glfwSetCursorPosCallback(window, Input::CursorPosCallback);
 	glfwSetKeyCallback(window, Input::KeyCallBack);
 
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	if (!headless)
+	{
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	}
 
 	// Set content
 	glfwMakeContextCurrent(window);
@@ -163,5 +584,14 @@ int init(GLFWwindow*& window)
 		return -2;
 	}
 
+	glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+	GLState::Invalidate();
+
+	// don't let vsync cap a benchmark run
+	if (benchmarkFrames != 0)
+	{
+		glfwSwapInterval(0);
+	}
+
 	return 0;
 }
\ No newline at end of file
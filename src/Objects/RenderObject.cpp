@@ -1,29 +1,42 @@
 #include "RenderObject.hpp"
-#include "Camera.hpp"
 #include "../core/Debug.hpp"
 
 RenderObject::RenderObject(Model* model, Material* material, glm::vec3 position, glm::quat rotation, glm::vec3 scale)
 	: Object(position, rotation, scale), material(material), model(model) { }
 
-void RenderObject::DrawObject() const
+void RenderObject::Submit(RenderQueue& queue) const
 {
-	material->Use();
+	Submit(queue, RenderObject::CalculateTransform(), nullptr);
+}
 
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_DEPTH);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-
-	glUniformMatrix4fv(glGetUniformLocation(material->shaderProgram, "transform"), 1, GL_FALSE, glm::value_ptr(RenderObject::CalculateTransform()));
-	glUniformMatrix4fv(glGetUniformLocation(material->shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(Camera::Instance()->view));
-	glUniformMatrix4fv(glGetUniformLocation(material->shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(Camera::Instance()->projection));
-
-	glUniform3fv(glGetUniformLocation(material->shaderProgram, "cameraPosition"), 1, glm::value_ptr(Camera::Instance()->position));
-	glUniform3fv(glGetUniformLocation(material->shaderProgram, "lightDirection"), 1, glm::value_ptr(Camera::Instance()->lightDirection));
-
-	model->Draw(material->shaderProgram);
-
-	glDisable(GL_BLEND);
+size_t RenderObject::Submit(RenderQueue& queue, const glm::mat4& transform, const unsigned char* meshVisible, unsigned int lod) const
+{
+	RenderQueue::DrawPacket packet;
+	packet.material = material;
+
+	size_t submitted = 0;
+	for (size_t i = 0; i < model->meshes.size(); i++)
+	{
+		if (meshVisible && !meshVisible[i]) { continue; }
+
+		Mesh& mesh = model->meshes[i];
+		packet.mesh = &mesh;
+		packet.lod = lod < mesh.lods.size() ? lod : (unsigned int)mesh.lods.size() - 1;
+		packet.transform = transform * mesh.dequantize;
+		queue.Submit(RenderQueue::OPAQUE_PASS, packet);
+		submitted++;
+	}
+	return submitted;
+}
+
+bool RenderObject::RefreshTransform()
+{
+	glm::mat4 current = RenderObject::CalculateTransform();
+	if (transformValid && current == transform) { return false; }
+
+	transform = current;
+	transformValid = true;
+	worldBounds = model->bounds.Transformed(transform);
+	worldSphere = TransformSphere(model->sphere, transform);
+	return true;
 }
\ No newline at end of file
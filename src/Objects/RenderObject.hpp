@@ -6,6 +6,7 @@
 #include <glm/gtx/quaternion.hpp>
 #include "../rendering/model.hpp"
 #include "../rendering/Material.hpp"
+#include "../rendering/RenderQueue.hpp"
 #include "Object.hpp"
 
 class RenderObject : public Object
@@ -13,8 +14,23 @@ class RenderObject : public Object
 public:
 	Material* material;
 	RenderObject(Model* model, Material* material, glm::vec3 position, glm::quat rotation = glm::quat(glm::vec3(0, 0, 0)), glm::vec3 scale = glm::vec3(1, 1, 1));
-	void DrawObject() const;
+	// adds a draw packet per mesh of the model
+	void Submit(RenderQueue& queue) const;
+	// same with a precomputed transform, meshVisible holds a flag per mesh and skips the culled ones when given.
+	// Meshes with fewer levels of detail use their coarsest one. Returns the number of meshes submitted
+	size_t Submit(RenderQueue& queue, const glm::mat4& transform, const unsigned char* meshVisible, unsigned int lod = 0) const;
+	const Model* GetModel() const { return model; }
+
+	// recomputes the cached transform and world bounds, returns whether the transform changed since the last call
+	bool RefreshTransform();
+	const glm::mat4& Transform() const { return transform; }
+	const AABB& WorldBounds() const { return worldBounds; }
+	const BoundingSphere& WorldSphere() const { return worldSphere; }
 
 private:
 	Model* model;
+	glm::mat4 transform;
+	AABB worldBounds;
+	BoundingSphere worldSphere;
+	bool transformValid = false;
 };
\ No newline at end of file
@@ -1,5 +1,16 @@
 #include "File.hpp"
+#include <cstdio>
 #include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#endif
+#include <sys/stat.h>
 
 void File::LoadFile(const char* filename, char*& output)
 {
@@ -23,4 +34,57 @@ void File::LoadFile(const char* filename, char*& output)
 	{
 		output = NULL;
 	}
-}
\ No newline at end of file
+}
+
+bool File::Size(const char* path, size_t& size)
+{
+	struct stat status;
+	if (stat(path, &status) != 0) { return false; }
+
+	size = (size_t)status.st_size;
+	return true;
+}
+
+void File::CreateDirectories(const char* path)
+{
+	std::string directory = path;
+
+	// every parent first, existing directories just fail
+	for (size_t separator = directory.find('/'); ; separator = directory.find('/', separator + 1))
+	{
+		std::string part = directory.substr(0, separator);
+		if (!part.empty())
+		{
+#ifdef _WIN32
+			_mkdir(part.c_str());
+#else
+			mkdir(part.c_str(), 0755);
+#endif
+		}
+		if (separator == std::string::npos) { break; }
+	}
+}
+
+bool File::WriteAtomic(const char* path, const void* data, size_t size)
+{
+	// the decode threads can write the same file at once, each writes its own temporary
+	std::string temporaryPath = std::string(path) + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!stream || !stream.write((const char*)data, (std::streamsize)size))
+		{
+			stream.close();
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+	}
+
+	// replaces an existing file in one step, readers see the old or the new file and never none
+#ifdef _WIN32
+	bool replaced = MoveFileExA(temporaryPath.c_str(), path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool replaced = std::rename(temporaryPath.c_str(), path) == 0;
+#endif
+	if (!replaced) { std::remove(temporaryPath.c_str()); }
+	return replaced;
+}
@@ -1,7 +1,17 @@
 #pragma once
 
+#include <cstddef>
+
 class File 
 {
 public:
 	static void LoadFile(const char* filename, char*& output);
+
+	// size in bytes without reading the file, false when it doesn't exist
+	static bool Size(const char* path, size_t& size);
+	// creates every missing directory of a '/' separated path
+	static void CreateDirectories(const char* path);
+	// writes a temporary next to the final name and moves it over, so a run that dies halfway never leaves a
+	// truncated file behind and readers never find the file missing
+	static bool WriteAtomic(const char* path, const void* data, size_t size);
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Input.hpp"
+#include "InputRecorder.hpp"
 
 bool Input::keys[1024] = { false };
 glm::vec2 Input::mousePos = glm::vec2(0, 0);
@@ -7,6 +8,9 @@ glm::vec2 Input::lastMousePos = glm::vec2(0, 0);
 
 void Input::CursorPosCallback(GLFWwindow* window, double xPos, double yPos)
 {
+	// a replay owns the input state, live devices must not interfere
+	if (InputRecorder::IsReplaying()) { return; }
+
 	Input::lastMousePos = Input::mousePos;
 	Input::mousePos.x = (float)xPos;
 	Input::mousePos.y = (float)yPos;
@@ -15,6 +19,9 @@ void Input::CursorPosCallback(GLFWwindow* window, double xPos, double yPos)
 
 void Input::KeyCallBack(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+	if (InputRecorder::IsReplaying()) { return; }
+	if (key < 0 || key >= 1024) { return; }
+
 	if (action == GLFW_PRESS)
 	{
 		Input::keys[key] = true;
@@ -0,0 +1,173 @@
+#include "InputRecorder.hpp"
+#include "Input.hpp"
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+bool InputRecorder::recording = false;
+bool InputRecorder::replaying = false;
+bool InputRecorder::replayFinished = false;
+
+std::ofstream InputRecorder::output;
+bool InputRecorder::recordedKeys[1024] = { false };
+uint32_t InputRecorder::recordedFrames = 0;
+
+std::vector<uint8_t> InputRecorder::replayData;
+size_t InputRecorder::replayOffset = 0;
+uint32_t InputRecorder::replayFrames = 0;
+uint32_t InputRecorder::replayedFrames = 0;
+
+template <typename T>
+static void writeValue(std::ofstream& stream, T value)
+{
+	stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readValue(const std::vector<uint8_t>& data, size_t& offset, T& value)
+{
+	if (offset + sizeof(T) > data.size()) { return false; }
+	std::memcpy(&value, data.data() + offset, sizeof(T));
+	offset += sizeof(T);
+	return true;
+}
+
+bool InputRecorder::StartRecording(const char* path)
+{
+	output.open(path, std::ios::binary | std::ios::trunc);
+	if (!output.is_open())
+	{
+		std::cout << "ERROR Could not open input recording " << path << std::endl;
+		return false;
+	}
+
+	output.write("GDIR", 4);
+	writeValue<uint32_t>(output, VERSION);
+	writeValue<uint32_t>(output, 0); // frame count, patched in Stop
+
+	std::memset(recordedKeys, 0, sizeof(recordedKeys));
+	recordedFrames = 0;
+	recording = true;
+	return true;
+}
+
+bool InputRecorder::StartReplay(const char* path)
+{
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream.is_open())
+	{
+		std::cout << "ERROR Could not open input recording " << path << std::endl;
+		return false;
+	}
+
+	replayData.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+	uint32_t version = 0;
+	replayOffset = 4;
+	if (replayData.size() < 12 || std::memcmp(replayData.data(), "GDIR", 4) != 0
+		|| !readValue(replayData, replayOffset, version) || version != VERSION
+		|| !readValue(replayData, replayOffset, replayFrames))
+	{
+		std::cout << "ERROR " << path << " is not a valid input recording" << std::endl;
+		replayData.clear();
+		return false;
+	}
+
+	replayedFrames = 0;
+	replayFinished = false;
+	replaying = true;
+	return true;
+}
+
+void InputRecorder::Stop()
+{
+	if (recording)
+	{
+		output.seekp(8);
+		writeValue<uint32_t>(output, recordedFrames);
+		output.close();
+		recording = false;
+	}
+
+	replaying = false;
+	replayData.clear();
+}
+
+void InputRecorder::BeginFrame()
+{
+	if (replaying)
+	{
+		ReplayFrame();
+	}
+	if (recording)
+	{
+		RecordFrame();
+	}
+}
+
+void InputRecorder::RecordFrame()
+{
+	std::vector<uint16_t> events;
+	for (uint16_t key = 0; key < 1024; key++)
+	{
+		if (Input::keys[key] != recordedKeys[key])
+		{
+			recordedKeys[key] = Input::keys[key];
+			events.push_back(key | (Input::keys[key] ? PRESSED_BIT : 0));
+		}
+	}
+
+	bool mouseMoved = Input::mouseDelta.x != 0.0f || Input::mouseDelta.y != 0.0f;
+
+	writeValue<uint16_t>(output, (uint16_t)events.size());
+	writeValue<uint8_t>(output, mouseMoved ? 1 : 0);
+	if (mouseMoved)
+	{
+		writeValue<float>(output, Input::mouseDelta.x);
+		writeValue<float>(output, Input::mouseDelta.y);
+	}
+	for (uint16_t event : events)
+	{
+		writeValue<uint16_t>(output, event);
+	}
+
+	recordedFrames++;
+}
+
+void InputRecorder::ReplayFrame()
+{
+	uint16_t eventCount = 0;
+	uint8_t flags = 0;
+	if (replayedFrames >= replayFrames
+		|| !readValue(replayData, replayOffset, eventCount)
+		|| !readValue(replayData, replayOffset, flags))
+	{
+		replayFinished = true;
+		return;
+	}
+
+	glm::vec2 mouseDelta(0.0f, 0.0f);
+	if (flags & 1)
+	{
+		readValue(replayData, replayOffset, mouseDelta.x);
+		readValue(replayData, replayOffset, mouseDelta.y);
+	}
+	Input::mouseDelta = mouseDelta;
+
+	for (uint16_t i = 0; i < eventCount; i++)
+	{
+		// a cut off or edited file can hold anything, a key outside Input::keys ends the replay instead of writing
+		uint16_t event = 0;
+		bool valid = readValue(replayData, replayOffset, event);
+		uint16_t key = event & ~PRESSED_BIT;
+		if (!valid || key >= sizeof(Input::keys) / sizeof(Input::keys[0]))
+		{
+			std::cout << "ERROR Input recording has an invalid key event, stopping the replay" << std::endl;
+			replayFinished = true;
+			return;
+		}
+		Input::keys[key] = (event & PRESSED_BIT) != 0;
+	}
+
+	replayedFrames++;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Records the per-frame input state (key transitions and mouse delta) to a compact binary file and replays it
+// frame by frame, so two runs fly exactly the same camera path regardless of wall-clock time.
+//
+// File layout: "GDIR", uint32 version, uint32 frame count, then per frame:
+//   uint16 key event count, uint8 flags (bit 0: mouse moved), [float dx, float dy], key events as uint16 (key | pressed << 15)
+class InputRecorder
+{
+public:
+	static bool StartRecording(const char* path);
+	static bool StartReplay(const char* path);
+	static void Stop();
+
+	// captures or injects the input for the coming frame, call once per frame before anything reads Input
+	static void BeginFrame();
+
+	static bool IsRecording() { return recording; }
+	static bool IsReplaying() { return replaying; }
+	static bool ReplayFinished() { return replayFinished; }
+
+private:
+	static const uint32_t VERSION = 1;
+	static const uint16_t PRESSED_BIT = 0x8000;
+
+	static bool recording;
+	static bool replaying;
+	static bool replayFinished;
+
+	static std::ofstream output;
+	static bool recordedKeys[1024];
+	static uint32_t recordedFrames;
+
+	static std::vector<uint8_t> replayData;
+	static size_t replayOffset;
+	static uint32_t replayFrames;
+	static uint32_t replayedFrames;
+
+	static void RecordFrame();
+	static void ReplayFrame();
+};
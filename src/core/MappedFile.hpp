@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+
+// Read only memory mapping of a whole file. Pages are only read when touched, so a cache file can be used in
+// place without copying it into a buffer first. The mapping lives until Close or destruction.
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// false when the file doesn't exist, is empty or can't be mapped
+	bool Open(const char* path);
+	void Close();
+
+	const unsigned char* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
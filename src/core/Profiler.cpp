@@ -0,0 +1,114 @@
+#include "Profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+std::vector<Profiler::Phase> Profiler::phases;
+unsigned int Profiler::frameCount = 0;
+Profiler::Clock::time_point Profiler::frameStart;
+int Profiler::framePhase = Profiler::RegisterPhase("frame");
+
+int Profiler::RegisterPhase(const char* name, Unit unit)
+{
+	for (size_t i = 0; i < phases.size(); i++)
+	{
+		if (phases[i].name == name) { return (int)i; }
+	}
+
+	Phase phase;
+	phase.name = name;
+	phase.unit = unit;
+	phase.current = 0.0;
+	phase.history.assign(HISTORY_FRAMES, 0.0f);
+	phases.push_back(phase);
+	return (int)phases.size() - 1;
+}
+
+void Profiler::BeginFrame()
+{
+	frameStart = Clock::now();
+}
+
+float Profiler::EndFrame()
+{
+	Clock::duration elapsed = Clock::now() - frameStart;
+	AddTime(framePhase, elapsed);
+
+	unsigned int slot = frameCount % HISTORY_FRAMES;
+	for (Phase& phase : phases)
+	{
+		phase.history[slot] = (float)phase.current;
+		phase.current = 0.0;
+	}
+	frameCount++;
+
+	return std::chrono::duration<float>(elapsed).count();
+}
+
+void Profiler::AddTime(int phase, Clock::duration elapsed)
+{
+	phases[phase].current += std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+void Profiler::AddCount(int phase, double count)
+{
+	phases[phase].current += count;
+}
+
+Profiler::Summary Profiler::Summarize(const Phase& phase)
+{
+	unsigned int count = std::min(frameCount, HISTORY_FRAMES);
+	if (count == 0) { return Summary{ 0, 0, 0, 0, 0 }; }
+
+	std::vector<float> samples(phase.history.begin(), phase.history.begin() + count);
+	std::sort(samples.begin(), samples.end());
+
+	// nearest-rank percentiles
+	auto percentile = [&](float p) {
+		size_t rank = (size_t)std::ceil(p * count);
+		return samples[std::min(std::max(rank, (size_t)1), (size_t)count) - 1];
+	};
+
+	double sum = 0.0;
+	for (float sample : samples) { sum += sample; }
+
+	return Summary{ (float)(sum / count), percentile(0.50f), percentile(0.95f), percentile(0.99f), samples.back() };
+}
+
+void Profiler::Report(std::ostream& out)
+{
+	unsigned int count = std::min(frameCount, HISTORY_FRAMES);
+	out << "Profile over the last " << count << " of " << frameCount << " frames" << std::endl;
+	out << std::left << std::setw(28) << "phase" << std::right
+		<< std::setw(12) << "avg" << std::setw(12) << "p50" << std::setw(12) << "p95"
+		<< std::setw(12) << "p99" << std::setw(12) << "max" << std::endl;
+
+	out << std::fixed << std::setprecision(3);
+	for (const Phase& phase : phases)
+	{
+		Summary summary = Summarize(phase);
+		std::string label = phase.name + (phase.unit == Unit::Milliseconds ? " (ms)" : "");
+		out << std::left << std::setw(28) << label << std::right
+			<< std::setw(12) << summary.average << std::setw(12) << summary.p50 << std::setw(12) << summary.p95
+			<< std::setw(12) << summary.p99 << std::setw(12) << summary.max << std::endl;
+	}
+	out << std::defaultfloat;
+}
+
+bool Profiler::WriteCSV(const char* path)
+{
+	std::ofstream stream(path);
+	if (!stream.is_open()) { return false; }
+
+	stream << "phase,unit,frames,avg,p50,p95,p99,max" << std::endl;
+	for (const Phase& phase : phases)
+	{
+		Summary summary = Summarize(phase);
+		stream << phase.name << "," << (phase.unit == Unit::Milliseconds ? "ms" : "count") << ","
+			<< std::min(frameCount, HISTORY_FRAMES) << "," << summary.average << "," << summary.p50 << ","
+			<< summary.p95 << "," << summary.p99 << "," << summary.max << std::endl;
+	}
+
+	return true;
+}
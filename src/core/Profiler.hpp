@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Collects per-frame phase timings and counters. Every phase keeps a rolling window of its last
+// HISTORY_FRAMES per-frame totals so the report can show spikes (p95/p99/max) instead of only an average.
+class Profiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	enum class Unit { Milliseconds, Count };
+
+	static const unsigned int HISTORY_FRAMES = 4096;
+
+	// phases are registered once (usually through a function-local static) and addressed by index afterwards
+	static int RegisterPhase(const char* name, Unit unit = Unit::Milliseconds);
+
+	static void BeginFrame();
+	// closes the current frame, commits all phase totals and returns the frame time in seconds
+	static float EndFrame();
+
+	static void AddTime(int phase, Clock::duration elapsed);
+	static void AddCount(int phase, double count);
+
+	static void Report(std::ostream& out);
+	static bool WriteCSV(const char* path);
+
+private:
+	struct Phase
+	{
+		std::string name;
+		Unit unit;
+		double current;
+		std::vector<float> history;
+	};
+
+	struct Summary
+	{
+		float average, p50, p95, p99, max;
+	};
+
+	static std::vector<Phase> phases;
+	static unsigned int frameCount;
+	static Clock::time_point frameStart;
+	static int framePhase;
+
+	static Summary Summarize(const Phase& phase);
+};
+
+// Adds the time between construction and destruction to a phase of the current frame.
+class ProfileScope
+{
+public:
+	explicit ProfileScope(int phase) : phase(phase), start(Profiler::Clock::now()) {}
+	~ProfileScope() { Profiler::AddTime(phase, Profiler::Clock::now() - start); }
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	int phase;
+	Profiler::Clock::time_point start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) \
+	static const int PROFILE_CONCAT(profilePhase_, __LINE__) = Profiler::RegisterPhase(name); \
+	ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(PROFILE_CONCAT(profilePhase_, __LINE__))
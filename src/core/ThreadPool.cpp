@@ -0,0 +1,75 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned int workerCount)
+{
+	if (workerCount == 0)
+	{
+		unsigned int hardware = std::thread::hardware_concurrency();
+		workerCount = hardware > 1 ? hardware - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::Run(size_t count, const std::function<void(size_t)>& job)
+{
+	if (count == 0) { return; }
+
+	std::unique_lock<std::mutex> lock(mutex);
+	currentJob = &job;
+	jobCount = count;
+	nextJob = 0;
+	finishedJobs = 0;
+	generation++;
+	wake.notify_all();
+
+	runJobs(lock);
+	done.wait(lock, [this] { return finishedJobs == jobCount; });
+	currentJob = nullptr;
+}
+
+void ThreadPool::runJobs(std::unique_lock<std::mutex>& lock)
+{
+	while (currentJob && nextJob < jobCount)
+	{
+		size_t index = nextJob++;
+		const std::function<void(size_t)>& job = *currentJob;
+
+		lock.unlock();
+		job(index);
+		lock.lock();
+
+		if (++finishedJobs == jobCount) { done.notify_all(); }
+	}
+}
+
+void ThreadPool::workerLoop()
+{
+	unsigned int seenGeneration = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this, &seenGeneration] { return stopping || generation != seenGeneration; });
+		if (stopping) { return; }
+
+		seenGeneration = generation;
+		runJobs(lock);
+	}
+}
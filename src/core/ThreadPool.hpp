@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run the jobs of one Run call at a time. The calling thread takes jobs as well
+// and Run only returns once every job is done, so jobs can use the caller's stack data.
+class ThreadPool
+{
+public:
+	// 0 uses one thread less than the hardware has, the caller is the last one
+	explicit ThreadPool(unsigned int workerCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// calls job(i) for every i in [0, jobCount), spread over the workers and the caller
+	void Run(size_t jobCount, const std::function<void(size_t)>& job);
+
+	unsigned int ThreadCount() const { return (unsigned int)workers.size() + 1; }
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const std::function<void(size_t)>* currentJob = nullptr;
+	size_t jobCount = 0;
+	size_t nextJob = 0;
+	size_t finishedJobs = 0;
+	unsigned int generation = 0;
+	bool stopping = false;
+
+	void workerLoop();
+	// takes jobs of the current run until none are left, expects the lock to be held and holds it again on return
+	void runJobs(std::unique_lock<std::mutex>& lock);
+};
@@ -0,0 +1,252 @@
+#include "BlockCompressor.hpp"
+#include <algorithm>
+#include <cmath>
+
+size_t BlockCompressor::LevelSize(Format format, int width, int height)
+{
+	size_t blocks = (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4);
+
+	switch (format)
+	{
+		case BC1:
+		case BC4:
+			return blocks * 8;
+		case BC3:
+		case BC5:
+			return blocks * 16;
+		default:
+			return (size_t)width * height * 4;
+	}
+}
+
+std::vector<unsigned char> BlockCompressor::Compress(Format format, const unsigned char* rgba, int width, int height)
+{
+	if (format == RGBA8) { return std::vector<unsigned char>(rgba, rgba + (size_t)width * height * 4); }
+
+	std::vector<unsigned char> output(LevelSize(format, width, height));
+	unsigned char* destination = output.data();
+	unsigned char block[16 * 4];
+
+	for (int blockY = 0; blockY < height; blockY += 4)
+	{
+		for (int blockX = 0; blockX < width; blockX += 4)
+		{
+			for (int y = 0; y < 4; y++)
+			{
+				const unsigned char* row = rgba + (size_t)std::min(blockY + y, height - 1) * width * 4;
+				for (int x = 0; x < 4; x++)
+				{
+					const unsigned char* texel = row + (size_t)std::min(blockX + x, width - 1) * 4;
+					std::copy(texel, texel + 4, block + (y * 4 + x) * 4);
+				}
+			}
+
+			switch (format)
+			{
+				case BC1:
+					encodeColorBlock(block, destination);
+					destination += 8;
+					break;
+				case BC3:
+					encodeAlphaBlock(block + 3, 4, destination);
+					encodeColorBlock(block, destination + 8);
+					destination += 16;
+					break;
+				case BC4:
+					encodeAlphaBlock(block, 4, destination);
+					destination += 8;
+					break;
+				case BC5:
+					encodeAlphaBlock(block, 4, destination);
+					encodeAlphaBlock(block + 1, 4, destination + 8);
+					destination += 16;
+					break;
+				default:
+					break;
+			}
+		}
+	}
+
+	return output;
+}
+
+void BlockCompressor::encodeColorBlock(const unsigned char* block, unsigned char* output)
+{
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++) { mean[c] += block[i * 4 + c]; }
+	}
+	for (int c = 0; c < 3; c++) { mean[c] /= 16.0f; }
+
+	// covariance of the colors, its largest eigenvector is the line the endpoints go on
+	float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		float r = block[i * 4] - mean[0], g = block[i * 4 + 1] - mean[1], b = block[i * 4 + 2] - mean[2];
+		covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+		covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+	}
+
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+		float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+		float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+		float length = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+		if (length < 1e-6f) { break; }
+		axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+	}
+
+	float minT = 0.0f, maxT = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = (block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	float axisLengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	if (axisLengthSquared > 0.0f) { minT /= axisLengthSquared; maxT /= axisLengthSquared; }
+
+	float endpoints[2][3];
+	for (int c = 0; c < 3; c++)
+	{
+		endpoints[0][c] = mean[c] + axis[c] * maxT;
+		endpoints[1][c] = mean[c] + axis[c] * minT;
+	}
+
+	unsigned short bestColors[2] = { 0, 0 };
+	unsigned int bestIndices = 0;
+	float bestError = -1.0f;
+
+	// the second round refits the endpoints to the indices the first one picked
+	for (int round = 0; round < 2; round++)
+	{
+		unsigned short colors[2] = { packColor(endpoints[0]), packColor(endpoints[1]) };
+		// four color mode needs the first endpoint to be the larger one, equal endpoints make every index the same color
+		if (colors[0] < colors[1]) { std::swap(colors[0], colors[1]); }
+
+		float palette[4][3];
+		unpackColor(colors[0], palette[0]);
+		unpackColor(colors[1], palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+
+		unsigned int indices;
+		float error = paletteError(block, palette, &indices);
+		if (bestError < 0.0f || error < bestError)
+		{
+			bestError = error;
+			bestColors[0] = colors[0];
+			bestColors[1] = colors[1];
+			bestIndices = indices;
+		}
+		if (colors[0] == colors[1] || round == 1) { break; }
+
+		// least squares endpoints for the chosen weights, texel = a * first + b * second
+		static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+		float ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			float a = weights[(indices >> (i * 2)) & 3], b = 1.0f - a;
+			aa += a * a; bb += b * b; ab += a * b;
+			for (int c = 0; c < 3; c++)
+			{
+				ax[c] += a * block[i * 4 + c];
+				bx[c] += b * block[i * 4 + c];
+			}
+		}
+
+		float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f) { break; }
+		for (int c = 0; c < 3; c++)
+		{
+			endpoints[0][c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+			endpoints[1][c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+		}
+	}
+
+	output[0] = (unsigned char)(bestColors[0] & 0xFF);
+	output[1] = (unsigned char)(bestColors[0] >> 8);
+	output[2] = (unsigned char)(bestColors[1] & 0xFF);
+	output[3] = (unsigned char)(bestColors[1] >> 8);
+	for (int i = 0; i < 4; i++) { output[4 + i] = (unsigned char)((bestIndices >> (i * 8)) & 0xFF); }
+}
+
+void BlockCompressor::encodeAlphaBlock(const unsigned char* values, int stride, unsigned char* output)
+{
+	int minValue = 255, maxValue = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		minValue = std::min(minValue, (int)values[i * stride]);
+		maxValue = std::max(maxValue, (int)values[i * stride]);
+	}
+
+	// eight value mode: the endpoints and six steps evenly spaced between them
+	output[0] = (unsigned char)maxValue;
+	output[1] = (unsigned char)minValue;
+
+	unsigned long long indices = 0;
+	if (maxValue > minValue)
+	{
+		int range = maxValue - minValue;
+		for (int i = 0; i < 16; i++)
+		{
+			// step 7 is the first endpoint, step 0 the second, the ones in between are stored as 8 - step
+			int step = ((values[i * stride] - minValue) * 14 + range) / (range * 2);
+			unsigned long long index = step == 7 ? 0 : step == 0 ? 1 : (unsigned long long)(8 - step);
+			indices |= index << (i * 3);
+		}
+	}
+
+	for (int i = 0; i < 6; i++) { output[2 + i] = (unsigned char)((indices >> (i * 8)) & 0xFF); }
+}
+
+unsigned short BlockCompressor::packColor(const float* color)
+{
+	int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+	int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+void BlockCompressor::unpackColor(unsigned short packed, float* color)
+{
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (float)((r << 3) | (r >> 2));
+	color[1] = (float)((g << 2) | (g >> 4));
+	color[2] = (float)((b << 3) | (b >> 2));
+}
+
+float BlockCompressor::paletteError(const unsigned char* block, const float palette[4][3], unsigned int* indices)
+{
+	float total = 0.0f;
+	*indices = 0;
+
+	for (int i = 0; i < 16; i++)
+	{
+		float best = -1.0f;
+		unsigned int bestIndex = 0;
+		for (unsigned int entry = 0; entry < 4; entry++)
+		{
+			float r = block[i * 4] - palette[entry][0];
+			float g = block[i * 4 + 1] - palette[entry][1];
+			float b = block[i * 4 + 2] - palette[entry][2];
+			float error = r * r + g * g + b * b;
+			if (best < 0.0f || error < best)
+			{
+				best = error;
+				bestIndex = entry;
+			}
+		}
+		total += best;
+		*indices |= bestIndex << (i * 2);
+	}
+
+	return total;
+}
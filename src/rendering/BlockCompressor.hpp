@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// CPU encoder for the BCn block formats GL 3.3 can sample: BC1 and BC3 (GL_EXT_texture_compression_s3tc)
+// and BC4 and BC5 (RGTC, core since GL 3.0). Every format works on 4x4 texel blocks, images whose size isn't
+// a multiple of 4 repeat their last row and column. Endpoints follow the principal axis of the block's colors
+// and are refined once with a least squares fit, which is slower than a bounding box but much closer to the source.
+class BlockCompressor
+{
+public:
+	enum Format { RGBA8, BC1, BC3, BC4, BC5 };
+
+	// bytes of one mip level of the given size
+	static size_t LevelSize(Format format, int width, int height);
+
+	// rgba is width * height RGBA8 texels. BC1 drops alpha, BC4 keeps red, BC5 red and green
+	static std::vector<unsigned char> Compress(Format format, const unsigned char* rgba, int width, int height);
+
+private:
+	static void encodeColorBlock(const unsigned char* block, unsigned char* output);
+	// values are 16 single channel texels taken every stride bytes
+	static void encodeAlphaBlock(const unsigned char* values, int stride, unsigned char* output);
+
+	static unsigned short packColor(const float* color);
+	static void unpackColor(unsigned short packed, float* color);
+	static float paletteError(const unsigned char* block, const float palette[4][3], unsigned int* indices);
+};
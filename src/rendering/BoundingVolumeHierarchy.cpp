@@ -0,0 +1,295 @@
+#include "BoundingVolumeHierarchy.hpp"
+#include "../core/Profiler.hpp"
+#include <algorithm>
+#include <cfloat>
+
+const float BoundingVolumeHierarchy::REBUILD_COST_FACTOR = 1.5f;
+
+int BoundingVolumeHierarchy::Add(const AABB& box)
+{
+	int item;
+	if (!freeItems.empty())
+	{
+		item = freeItems.back();
+		freeItems.pop_back();
+	}
+	else
+	{
+		item = (int)items.size();
+		items.push_back(Item());
+	}
+
+	items[item].box = box;
+	items[item].centroid = box.Center();
+	items[item].leaf = -1;
+	items[item].alive = true;
+	needsBuild = true;
+	return item;
+}
+
+void BoundingVolumeHierarchy::Update(int item, const AABB& box)
+{
+	items[item].box = box;
+	items[item].centroid = box.Center();
+	markDirty(item);
+}
+
+void BoundingVolumeHierarchy::Remove(int item)
+{
+	items[item].alive = false;
+	freeItems.push_back(item);
+	// the handle can be handed out again, the rebuild takes it out of its old leaf first
+	needsBuild = true;
+}
+
+void BoundingVolumeHierarchy::markDirty(int item)
+{
+	int leaf = items[item].leaf;
+	if (leaf < 0 || nodes[leaf].dirty) { return; }
+
+	nodes[leaf].dirty = true;
+	dirtyLeaves.push_back(leaf);
+}
+
+AABB BoundingVolumeHierarchy::leafBounds(const Node& node) const
+{
+	AABB box;
+	for (int i = node.firstItem; i < node.firstItem + node.itemCount; i++)
+	{
+		if (items[order[i]].alive) { box.Expand(items[order[i]].box); }
+	}
+	return box;
+}
+
+void BoundingVolumeHierarchy::Refit()
+{
+	if (needsBuild || (builtCost > 0.0f && cost > builtCost * REBUILD_COST_FACTOR))
+	{
+		Build();
+		return;
+	}
+
+	for (int leaf : dirtyLeaves)
+	{
+		nodes[leaf].dirty = false;
+
+		// walk up until a box comes out the same, everything above it already encloses the change
+		int index = leaf;
+		AABB box = leafBounds(nodes[index]);
+		while (index >= 0)
+		{
+			Node& node = nodes[index];
+			if (node.left >= 0)
+			{
+				box = nodes[node.left].box;
+				box.Expand(nodes[node.right].box);
+			}
+			if (box.min == node.box.min && box.max == node.box.max) { break; }
+
+			cost += box.HalfArea() - node.box.HalfArea();
+			node.box = box;
+			index = node.parent;
+		}
+	}
+	dirtyLeaves.clear();
+}
+
+void BoundingVolumeHierarchy::Build()
+{
+	PROFILE_SCOPE("BoundingVolumeHierarchy::Build");
+
+	order.clear();
+	for (int i = 0; i < (int)items.size(); i++)
+	{
+		items[i].leaf = -1;
+		if (items[i].alive) { order.push_back(i); }
+	}
+
+	nodes.clear();
+	nodes.reserve(order.size() / MAX_LEAF_ITEMS * 2 + 1);
+	dirtyLeaves.clear();
+	cost = 0.0f;
+	if (!order.empty()) { buildNode(-1, 0, (int)order.size()); }
+
+	builtCost = cost;
+	needsBuild = false;
+}
+
+int BoundingVolumeHierarchy::buildNode(int parent, int begin, int end)
+{
+	int index = (int)nodes.size();
+	nodes.push_back(Node());
+
+	AABB box, centroids;
+	for (int i = begin; i < end; i++)
+	{
+		box.Expand(items[order[i]].box);
+		centroids.Expand(items[order[i]].centroid);
+	}
+
+	Node node;
+	node.box = box;
+	node.parent = parent;
+	node.left = node.right = -1;
+	node.firstItem = begin;
+	node.itemCount = end - begin;
+	node.dirty = false;
+	cost += box.HalfArea();
+
+	glm::vec3 spread = centroids.max - centroids.min;
+	int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+
+	if (end - begin <= MAX_LEAF_ITEMS || spread[axis] <= 0.0f)
+	{
+		for (int i = begin; i < end; i++) { items[order[i]].leaf = index; }
+		nodes[index] = node;
+		return index;
+	}
+
+	// median split on the centroids along the widest axis
+	int middle = begin + (end - begin) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+		[this, axis](int a, int b) { return items[a].centroid[axis] < items[b].centroid[axis]; });
+
+	nodes[index] = node;
+	int left = buildNode(index, begin, middle);
+	int right = buildNode(index, middle, end);
+	nodes[index].left = left;
+	nodes[index].right = right;
+	return index;
+}
+
+void BoundingVolumeHierarchy::appendItems(const Node& node, std::vector<int>& results) const
+{
+	for (int i = node.firstItem; i < node.firstItem + node.itemCount; i++)
+	{
+		if (items[order[i]].alive) { results.push_back(order[i]); }
+	}
+}
+
+void BoundingVolumeHierarchy::QueryFrustum(const Frustum& frustum, std::vector<int>& inside, std::vector<int>& partial) const
+{
+	visitedNodes = 0;
+	if (nodes.empty()) { return; }
+
+	int stack[MAX_DEPTH];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+		visitedNodes++;
+
+		Frustum::Containment containment = frustum.Classify(node.box);
+		if (containment == Frustum::OUTSIDE) { continue; }
+
+		if (containment == Frustum::INSIDE) { appendItems(node, inside); }
+		else if (node.left < 0) { appendItems(node, partial); }
+		else
+		{
+			stack[top++] = node.right;
+			stack[top++] = node.left;
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::QuerySphere(const BoundingSphere& sphere, std::vector<int>& results) const
+{
+	if (nodes.empty()) { return; }
+
+	int stack[MAX_DEPTH];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+		if (!node.box.Overlaps(sphere)) { continue; }
+
+		if (node.left >= 0)
+		{
+			stack[top++] = node.right;
+			stack[top++] = node.left;
+			continue;
+		}
+
+		for (int i = node.firstItem; i < node.firstItem + node.itemCount; i++)
+		{
+			const Item& item = items[order[i]];
+			if (item.alive && item.box.Overlaps(sphere)) { results.push_back(order[i]); }
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::QueryBox(const AABB& box, std::vector<int>& results) const
+{
+	if (nodes.empty()) { return; }
+
+	int stack[MAX_DEPTH];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+		if (!node.box.Overlaps(box)) { continue; }
+
+		if (node.left >= 0)
+		{
+			stack[top++] = node.right;
+			stack[top++] = node.left;
+			continue;
+		}
+
+		for (int i = node.firstItem; i < node.firstItem + node.itemCount; i++)
+		{
+			const Item& item = items[order[i]];
+			if (item.alive && item.box.Overlaps(box)) { results.push_back(order[i]); }
+		}
+	}
+}
+
+int BoundingVolumeHierarchy::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const
+{
+	int hit = -1;
+	distance = maxDistance;
+	if (nodes.empty()) { return hit; }
+
+	glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	int stack[MAX_DEPTH];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+		float entry;
+		if (!node.box.Raycast(origin, inverseDirection, distance, entry)) { continue; }
+
+		if (node.left < 0)
+		{
+			for (int i = node.firstItem; i < node.firstItem + node.itemCount; i++)
+			{
+				const Item& item = items[order[i]];
+				if (item.alive && item.box.Raycast(origin, inverseDirection, distance, entry))
+				{
+					distance = entry;
+					hit = order[i];
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first so the shrinking distance prunes the other one
+		float leftEntry = FLT_MAX, rightEntry = FLT_MAX;
+		bool hitsLeft = nodes[node.left].box.Raycast(origin, inverseDirection, distance, leftEntry);
+		bool hitsRight = nodes[node.right].box.Raycast(origin, inverseDirection, distance, rightEntry);
+		if (hitsLeft && hitsRight)
+		{
+			bool leftFirst = leftEntry <= rightEntry;
+			stack[top++] = leftFirst ? node.right : node.left;
+			stack[top++] = leftFirst ? node.left : node.right;
+		}
+		else if (hitsLeft) { stack[top++] = node.left; }
+		else if (hitsRight) { stack[top++] = node.right; }
+	}
+	return hit;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "Bounds.hpp"
+#include "Frustum.hpp"
+
+// Bounding volume hierarchy over world space boxes, addressed by the handle Add returns. The nodes are laid out
+// depth first and every node covers a contiguous range of the item order, so a subtree that is completely inside
+// a query is reported without visiting its children.
+// Moving an item only marks its leaf; Refit, called once before the frame's queries, grows the boxes from the
+// dirty leaves up to the root and rebuilds the tree when items were added or removed, or when the refitted boxes
+// have become so loose that the total node area exceeds REBUILD_COST_FACTOR times the area after the last build.
+class BoundingVolumeHierarchy
+{
+public:
+	static const int MAX_LEAF_ITEMS = 4;
+	static const float REBUILD_COST_FACTOR;
+
+	int Add(const AABB& box);
+	void Update(int item, const AABB& box);
+	void Remove(int item);
+
+	void Refit();
+	void Build();
+
+	// inside gets the items whose subtree is completely in the frustum, partial the items of leaves that cross it
+	void QueryFrustum(const Frustum& frustum, std::vector<int>& inside, std::vector<int>& partial) const;
+	void QuerySphere(const BoundingSphere& sphere, std::vector<int>& results) const;
+	void QueryBox(const AABB& box, std::vector<int>& results) const;
+	// closest item whose box the ray enters within maxDistance, -1 when there is none
+	int Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+
+	const AABB& ItemBounds(int item) const { return items[item].box; }
+	size_t ItemCount() const { return items.size() - freeItems.size(); }
+	size_t NodeCount() const { return nodes.size(); }
+	// nodes visited by the last QueryFrustum
+	size_t VisitedNodes() const { return visitedNodes; }
+
+private:
+	// deep enough for any tree Build makes, the median split halves the items on every level
+	static const int MAX_DEPTH = 64;
+
+	struct Node
+	{
+		AABB box;
+		int parent;
+		// children, -1 for leaves
+		int left, right;
+		// range in order covered by this node
+		int firstItem, itemCount;
+		bool dirty;
+	};
+
+	struct Item
+	{
+		AABB box;
+		glm::vec3 centroid;
+		int leaf;
+		bool alive;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Item> items;
+	std::vector<int> order;
+	std::vector<int> freeItems;
+	std::vector<int> dirtyLeaves;
+
+	bool needsBuild = false;
+	float builtCost = 0.0f;
+	float cost = 0.0f;
+	mutable size_t visitedNodes = 0;
+
+	int buildNode(int parent, int begin, int end);
+	void markDirty(int item);
+	AABB leafBounds(const Node& node) const;
+	void appendItems(const Node& node, std::vector<int>& results) const;
+};
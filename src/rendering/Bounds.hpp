@@ -0,0 +1,99 @@
+#pragma once
+#include <cfloat>
+#include <cmath>
+#include <glm/glm.hpp>
+
+struct BoundingSphere
+{
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+};
+
+struct AABB
+{
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+
+	bool IsValid() const { return min.x <= max.x; }
+
+	void Expand(const glm::vec3& point)
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void Expand(const AABB& other)
+	{
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	bool Overlaps(const AABB& other) const
+	{
+		return min.x <= other.max.x && max.x >= other.min.x &&
+			min.y <= other.max.y && max.y >= other.min.y &&
+			min.z <= other.max.z && max.z >= other.min.z;
+	}
+
+	bool Overlaps(const BoundingSphere& sphere) const
+	{
+		glm::vec3 closest = glm::min(glm::max(sphere.center, min), max);
+		glm::vec3 offset = closest - sphere.center;
+		return glm::dot(offset, offset) <= sphere.radius * sphere.radius;
+	}
+
+	// slab test, distance is where the ray enters the box (0 when it starts inside)
+	bool Raycast(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& distance) const
+	{
+		float tMin = 0.0f, tMax = maxDistance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float t0 = (min[axis] - origin[axis]) * inverseDirection[axis];
+			float t1 = (max[axis] - origin[axis]) * inverseDirection[axis];
+			if (t0 > t1) { float swap = t0; t0 = t1; t1 = swap; }
+			tMin = t0 > tMin ? t0 : tMin;
+			tMax = t1 < tMax ? t1 : tMax;
+			if (tMin > tMax) { return false; }
+		}
+		distance = tMin;
+		return true;
+	}
+
+	// half the surface area, the cost measure of the hierarchy
+	float HalfArea() const
+	{
+		glm::vec3 size = max - min;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	glm::vec3 Center() const { return (min + max) * 0.5f; }
+	glm::vec3 Extents() const { return (max - min) * 0.5f; }
+
+	// box around this box after an affine transform
+	AABB Transformed(const glm::mat4& transform) const
+	{
+		glm::vec3 center = glm::vec3(transform * glm::vec4(Center(), 1.0f));
+		glm::vec3 extents = Extents();
+		glm::vec3 worldExtents(0.0f);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			worldExtents += glm::abs(glm::vec3(transform[axis])) * extents[axis];
+		}
+
+		AABB box;
+		box.min = center - worldExtents;
+		box.max = center + worldExtents;
+		return box;
+	}
+};
+
+// sphere after an affine transform, the radius grows with the largest axis scale
+inline BoundingSphere TransformSphere(const BoundingSphere& sphere, const glm::mat4& transform)
+{
+	float scale = glm::max(glm::length(glm::vec3(transform[0])), glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+
+	BoundingSphere result;
+	result.center = glm::vec3(transform * glm::vec4(sphere.center, 1.0f));
+	result.radius = sphere.radius * scale;
+	return result;
+}
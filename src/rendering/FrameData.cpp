@@ -0,0 +1,41 @@
+#include "FrameData.hpp"
+#include "../Objects/Camera.hpp"
+
+const char* FrameData::BLOCK_NAME = "FrameData";
+GLuint FrameData::buffer = 0;
+
+static_assert(sizeof(glm::mat4) == 64 && sizeof(glm::vec3) == 12, "FrameData::Block has to follow the std140 layout");
+
+void FrameData::Init()
+{
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, buffer);
+}
+
+void FrameData::Update(const Camera& camera, float time)
+{
+	Block block;
+	block.view = camera.view;
+	block.projection = camera.projection;
+	block.cameraPosition = camera.position;
+	block.time = time;
+	block.lightDirection = camera.lightDirection;
+	block.padding = 0.0f;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void FrameData::BindBlock(GLuint program)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(program, BLOCK_NAME);
+	if (blockIndex != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(program, blockIndex, BINDING);
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class Camera;
+
+// Uniform buffer with the camera and light data every shader reads (assets/shaders/frameData.glsl). It is filled
+// once per frame after the camera has moved and stays bound to BINDING, so draws no longer upload any of it.
+class FrameData
+{
+public:
+	static const GLuint BINDING = 0;
+	static const char* BLOCK_NAME;
+
+	static void Init();
+	static void Update(const Camera& camera, float time);
+
+	// points the FrameData block of a linked program at BINDING, programs without the block are left alone
+	static void BindBlock(GLuint program);
+
+private:
+	// std140 layout, has to match frameData.glsl
+	struct Block
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 cameraPosition;
+		float time;
+		glm::vec3 lightDirection;
+		float padding;
+	};
+
+	static GLuint buffer;
+};
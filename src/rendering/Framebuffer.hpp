@@ -0,0 +1,21 @@
+#pragma once
+#include <glad/glad.h>
+
+// Offscreen render target with a color and depth attachment, used when there is no window to present to.
+class Framebuffer
+{
+public:
+	GLuint fbo;
+	GLuint colorBuffer;
+	GLuint depthBuffer;
+	int width, height;
+
+	Framebuffer(int width, int height);
+	~Framebuffer();
+
+	Framebuffer(const Framebuffer&) = delete;
+	Framebuffer& operator=(const Framebuffer&) = delete;
+
+	void Bind() const;
+	static void BindDefault();
+};
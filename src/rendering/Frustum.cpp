@@ -0,0 +1,122 @@
+#include "Frustum.hpp"
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+Frustum Frustum::FromMatrix(const glm::mat4& viewProjection)
+{
+	// Gribb/Hartmann, the planes are sums and differences of the matrix rows
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; row++)
+	{
+		rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+	}
+
+	Frustum frustum;
+	frustum.planes[LEFT] = rows[3] + rows[0];
+	frustum.planes[RIGHT] = rows[3] - rows[0];
+	frustum.planes[BOTTOM] = rows[3] + rows[1];
+	frustum.planes[TOP] = rows[3] - rows[1];
+	frustum.planes[NEAR_PLANE] = rows[3] + rows[2];
+	frustum.planes[FAR_PLANE] = rows[3] - rows[2];
+
+	for (glm::vec4& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
+
+bool Frustum::Intersects(const BoundingSphere& sphere) const
+{
+	for (const glm::vec4& plane : planes)
+	{
+		if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) { return false; }
+	}
+	return true;
+}
+
+bool Frustum::Intersects(const AABB& box) const
+{
+	// test the corner furthest along each plane normal
+	for (const glm::vec4& plane : planes)
+	{
+		glm::vec3 corner(plane.x >= 0.0f ? box.max.x : box.min.x,
+			plane.y >= 0.0f ? box.max.y : box.min.y,
+			plane.z >= 0.0f ? box.max.z : box.min.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) { return false; }
+	}
+	return true;
+}
+
+Frustum::Containment Frustum::Classify(const AABB& box) const
+{
+	Containment result = INSIDE;
+	for (const glm::vec4& plane : planes)
+	{
+		glm::vec3 furthest(plane.x >= 0.0f ? box.max.x : box.min.x,
+			plane.y >= 0.0f ? box.max.y : box.min.y,
+			plane.z >= 0.0f ? box.max.z : box.min.z);
+		if (glm::dot(glm::vec3(plane), furthest) + plane.w < 0.0f) { return OUTSIDE; }
+
+		glm::vec3 nearest(plane.x >= 0.0f ? box.min.x : box.max.x,
+			plane.y >= 0.0f ? box.min.y : box.max.y,
+			plane.z >= 0.0f ? box.min.z : box.max.z);
+		if (glm::dot(glm::vec3(plane), nearest) + plane.w < 0.0f) { result = INTERSECTING; }
+	}
+	return result;
+}
+
+size_t Frustum::CullSpheres(const float* x, const float* y, const float* z, const float* radius, size_t count, unsigned char* visible) const
+{
+	size_t visibleCount = 0;
+	size_t i = 0;
+
+#ifdef FRUSTUM_SSE
+	__m128 planeX[PLANE_COUNT], planeY[PLANE_COUNT], planeZ[PLANE_COUNT], planeW[PLANE_COUNT];
+	for (int p = 0; p < PLANE_COUNT; p++)
+	{
+		planeX[p] = _mm_set1_ps(planes[p].x);
+		planeY[p] = _mm_set1_ps(planes[p].y);
+		planeZ[p] = _mm_set1_ps(planes[p].z);
+		planeW[p] = _mm_set1_ps(planes[p].w);
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 sx = _mm_loadu_ps(x + i);
+		__m128 sy = _mm_loadu_ps(y + i);
+		__m128 sz = _mm_loadu_ps(z + i);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+		// a lane stays set while its sphere is not fully behind any plane
+		__m128 inside = _mm_cmpeq_ps(sx, sx);
+		for (int p = 0; p < PLANE_COUNT; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, planeX[p]), _mm_mul_ps(sy, planeY[p])),
+				_mm_add_ps(_mm_mul_ps(sz, planeZ[p]), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			visible[i + lane] = (mask >> lane) & 1;
+			visibleCount += visible[i + lane];
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		BoundingSphere sphere;
+		sphere.center = glm::vec3(x[i], y[i], z[i]);
+		sphere.radius = radius[i];
+		visible[i] = Intersects(sphere) ? 1 : 0;
+		visibleCount += visible[i];
+	}
+
+	return visibleCount;
+}
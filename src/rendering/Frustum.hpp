@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "Bounds.hpp"
+
+// The six planes of a view-projection matrix, normals pointing inwards. Culling works on spheres stored as
+// separate x/y/z/radius arrays so four of them are tested against a plane per SSE instruction.
+class Frustum
+{
+public:
+	enum { LEFT, RIGHT, BOTTOM, TOP, NEAR_PLANE, FAR_PLANE, PLANE_COUNT };
+	enum Containment { OUTSIDE, INTERSECTING, INSIDE };
+
+	glm::vec4 planes[PLANE_COUNT];
+
+	static Frustum FromMatrix(const glm::mat4& viewProjection);
+
+	bool Intersects(const BoundingSphere& sphere) const;
+	bool Intersects(const AABB& box) const;
+	// lets hierarchy traversal skip the tests below a node that is completely inside
+	Containment Classify(const AABB& box) const;
+
+	// visible[i] becomes 1 when sphere i touches the frustum and 0 otherwise, returns the visible count
+	size_t CullSpheres(const float* x, const float* y, const float* z, const float* radius, size_t count, unsigned char* visible) const;
+};
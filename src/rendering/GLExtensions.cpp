@@ -0,0 +1,28 @@
+#include "GLExtensions.hpp"
+#include <cstring>
+
+bool GLExtensions::Supported(const char* extension)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+	for (GLint i = 0; i < count; i++)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name != nullptr && std::strcmp(name, extension) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool GLExtensions::VersionAtLeast(int major, int minor)
+{
+	GLint contextMajor = 0, contextMinor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+
+	return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <glad/glad.h>
+
+// Runtime queries for features that are not part of the GL 3.3 core profile glad was generated for.
+class GLExtensions
+{
+public:
+	static bool Supported(const char* extension);
+	static bool VersionAtLeast(int major, int minor);
+};
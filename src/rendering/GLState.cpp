@@ -0,0 +1,197 @@
+#include "GLState.hpp"
+#include "../core/Profiler.hpp"
+
+GLuint GLState::program = GLState::UNKNOWN;
+int GLState::capabilities[GLState::CAPABILITY_COUNT];
+GLenum GLState::blendSource = GLState::UNKNOWN;
+GLenum GLState::blendDestination = GLState::UNKNOWN;
+GLenum GLState::cullFace = GLState::UNKNOWN;
+GLenum GLState::depthFunc = GLState::UNKNOWN;
+int GLState::depthMask = -1;
+int GLState::colorMask = -1;
+GLuint GLState::vertexArray = GLState::UNKNOWN;
+GLenum GLState::activeTexture = GLState::UNKNOWN;
+GLuint GLState::textures[GLState::MAX_TEXTURE_UNITS][GLState::TARGET_COUNT];
+
+unsigned int GLState::issuedCalls = 0;
+unsigned int GLState::filteredCalls = 0;
+unsigned int GLState::textureBinds = 0;
+
+int GLState::capabilityIndex(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST: return DEPTH_TEST;
+	case GL_CULL_FACE: return CULL_FACE;
+	case GL_BLEND: return BLEND;
+	default: return -1;
+	}
+}
+
+int GLState::targetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return TEXTURE_2D;
+	case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY;
+	default: return -1;
+	}
+}
+
+void GLState::UseProgram(GLuint newProgram)
+{
+	if (program == newProgram) { filteredCalls++; return; }
+	program = newProgram;
+	glUseProgram(newProgram);
+	issuedCalls++;
+}
+
+void GLState::setCapability(GLenum capability, bool enabled)
+{
+	int index = capabilityIndex(capability);
+	if (index >= 0 && capabilities[index] == (int)enabled) { filteredCalls++; return; }
+	if (index >= 0) { capabilities[index] = (int)enabled; }
+
+	if (enabled) { glEnable(capability); }
+	else { glDisable(capability); }
+	issuedCalls++;
+}
+
+void GLState::Enable(GLenum capability)
+{
+	setCapability(capability, true);
+}
+
+void GLState::Disable(GLenum capability)
+{
+	setCapability(capability, false);
+}
+
+void GLState::BlendFunc(GLenum source, GLenum destination)
+{
+	if (blendSource == source && blendDestination == destination) { filteredCalls++; return; }
+	blendSource = source;
+	blendDestination = destination;
+	glBlendFunc(source, destination);
+	issuedCalls++;
+}
+
+void GLState::CullFace(GLenum mode)
+{
+	if (cullFace == mode) { filteredCalls++; return; }
+	cullFace = mode;
+	glCullFace(mode);
+	issuedCalls++;
+}
+
+void GLState::DepthFunc(GLenum func)
+{
+	if (depthFunc == func) { filteredCalls++; return; }
+	depthFunc = func;
+	glDepthFunc(func);
+	issuedCalls++;
+}
+
+void GLState::DepthMask(GLboolean mask)
+{
+	if (depthMask == (int)mask) { filteredCalls++; return; }
+	depthMask = (int)mask;
+	glDepthMask(mask);
+	issuedCalls++;
+}
+
+void GLState::ColorMask(GLboolean mask)
+{
+	if (colorMask == (int)mask) { filteredCalls++; return; }
+	colorMask = (int)mask;
+	glColorMask(mask, mask, mask, mask);
+	issuedCalls++;
+}
+
+void GLState::BindVertexArray(GLuint vao)
+{
+	if (vertexArray == vao) { filteredCalls++; return; }
+	vertexArray = vao;
+	glBindVertexArray(vao);
+	issuedCalls++;
+}
+
+void GLState::ActiveTexture(GLenum unit)
+{
+	if (activeTexture == unit) { filteredCalls++; return; }
+	activeTexture = unit;
+	glActiveTexture(unit);
+	issuedCalls++;
+}
+
+void GLState::BindTexture(GLenum target, GLuint texture)
+{
+	int index = targetIndex(target);
+	GLuint unit = activeTexture == UNKNOWN ? UNKNOWN : activeTexture - GL_TEXTURE0;
+
+	if (index >= 0 && unit < MAX_TEXTURE_UNITS)
+	{
+		if (textures[unit][index] == texture) { filteredCalls++; return; }
+		textures[unit][index] = texture;
+	}
+
+	glBindTexture(target, texture);
+	issuedCalls++;
+	textureBinds++;
+}
+
+void GLState::BindTextureUnit(GLuint unit, GLenum target, GLuint texture)
+{
+	int index = targetIndex(target);
+	if (index >= 0 && unit < MAX_TEXTURE_UNITS && textures[unit][index] == texture)
+	{
+		filteredCalls++;
+		return;
+	}
+
+	ActiveTexture(GL_TEXTURE0 + unit);
+	BindTexture(target, texture);
+}
+
+void GLState::Invalidate()
+{
+	program = UNKNOWN;
+	for (int i = 0; i < CAPABILITY_COUNT; i++) { capabilities[i] = -1; }
+	blendSource = blendDestination = UNKNOWN;
+	cullFace = UNKNOWN;
+	depthFunc = UNKNOWN;
+	depthMask = -1;
+	colorMask = -1;
+	vertexArray = UNKNOWN;
+	activeTexture = UNKNOWN;
+	for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+	{
+		for (int target = 0; target < TARGET_COUNT; target++)
+		{
+			textures[unit][target] = UNKNOWN;
+		}
+	}
+}
+
+void GLState::ForgetTexture(GLuint texture)
+{
+	// GL unbinds a deleted texture from every unit and may hand its name out again
+	for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+	{
+		for (int target = 0; target < TARGET_COUNT; target++)
+		{
+			if (textures[unit][target] == texture) { textures[unit][target] = UNKNOWN; }
+		}
+	}
+}
+
+void GLState::EndFrame()
+{
+	static const int issuedPhase = Profiler::RegisterPhase("gl state calls issued", Profiler::Unit::Count);
+	static const int filteredPhase = Profiler::RegisterPhase("gl state calls filtered", Profiler::Unit::Count);
+
+	Profiler::AddCount(issuedPhase, issuedCalls);
+	Profiler::AddCount(filteredPhase, filteredCalls);
+	issuedCalls = 0;
+	filteredCalls = 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <glad/glad.h>
+
+// Shadow copy of the GL state the renderer touches. Every state change goes through here and is only passed on
+// to the driver when it actually changes something; the issued/filtered call counts are reported per frame.
+// Code that changes this state behind the cache's back has to call Invalidate afterwards.
+class GLState
+{
+public:
+	static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+	static void UseProgram(GLuint program);
+
+	static void Enable(GLenum capability);
+	static void Disable(GLenum capability);
+	static void BlendFunc(GLenum source, GLenum destination);
+	static void CullFace(GLenum mode);
+	static void DepthFunc(GLenum func);
+	static void DepthMask(GLboolean mask);
+	// all four channels at once, the depth pre-pass is the only thing that masks color
+	static void ColorMask(GLboolean mask);
+
+	static void BindVertexArray(GLuint vao);
+
+	static void ActiveTexture(GLenum unit);
+	// binds to the currently active unit
+	static void BindTexture(GLenum target, GLuint texture);
+	static void BindTextureUnit(GLuint unit, GLenum target, GLuint texture);
+
+	// texture binds that reached the driver since startup, passes diff it to count their own binds
+	static unsigned int TextureBinds() { return textureBinds; }
+
+	// forgets everything, the next call for every piece of state goes to the driver
+	static void Invalidate();
+	// call after glDeleteTextures, the units that had the texture bound are asked again
+	static void ForgetTexture(GLuint texture);
+
+	// hands this frame's counters to the Profiler
+	static void EndFrame();
+
+private:
+	enum Capability { DEPTH_TEST, CULL_FACE, BLEND, CAPABILITY_COUNT };
+	enum TextureTarget { TEXTURE_2D, TEXTURE_2D_ARRAY, TARGET_COUNT };
+
+	static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+	static GLuint program;
+	static int capabilities[CAPABILITY_COUNT];
+	static GLenum blendSource, blendDestination;
+	static GLenum cullFace;
+	static GLenum depthFunc;
+	static int depthMask;
+	static int colorMask;
+	static GLuint vertexArray;
+	static GLenum activeTexture;
+	static GLuint textures[MAX_TEXTURE_UNITS][TARGET_COUNT];
+
+	static unsigned int issuedCalls;
+	static unsigned int filteredCalls;
+	static unsigned int textureBinds;
+
+	static int capabilityIndex(GLenum capability);
+	static int targetIndex(GLenum target);
+	static void setCapability(GLenum capability, bool enabled);
+};
@@ -0,0 +1,219 @@
+#include "GeometryArena.hpp"
+#include "GLState.hpp"
+#include <glm/glm.hpp>
+#include <iterator>
+
+std::vector<GeometryArena*> GeometryArena::arenas;
+
+bool RangeAllocator::Allocate(size_t size, size_t& offset)
+{
+	if (size == 0) { offset = 0; return true; }
+
+	for (auto range = freeRanges.begin(); range != freeRanges.end(); ++range)
+	{
+		if (range->second < size) { continue; }
+
+		offset = range->first;
+		size_t remaining = range->second - size;
+		freeRanges.erase(range);
+		if (remaining > 0) { freeRanges[offset + size] = remaining; }
+
+		used += size;
+		return true;
+	}
+	return false;
+}
+
+void RangeAllocator::Free(size_t offset, size_t size)
+{
+	if (size == 0) { return; }
+	used -= size;
+
+	auto next = freeRanges.lower_bound(offset);
+	if (next != freeRanges.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = freeRanges.erase(next);
+	}
+	if (next != freeRanges.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+	freeRanges[offset] = size;
+}
+
+void RangeAllocator::Grow(size_t newCapacity)
+{
+	if (newCapacity <= capacity) { return; }
+
+	size_t added = newCapacity - capacity;
+	size_t oldCapacity = capacity;
+	capacity = newCapacity;
+
+	// hand the new space to Free so it merges with a free range at the old end
+	used += added;
+	Free(oldCapacity, added);
+}
+
+size_t RangeAllocator::LargestFree() const
+{
+	size_t largest = 0;
+	for (const auto& range : freeRanges)
+	{
+		if (range.second > largest) { largest = range.second; }
+	}
+	return largest;
+}
+
+float RangeAllocator::Fragmentation() const
+{
+	size_t free = capacity - used;
+	if (free == 0) { return 0.0f; }
+	return 1.0f - (float)LargestFree() / (float)free;
+}
+
+GeometryArena& GeometryArena::ForLayout(GLsizei vertexSize, LayoutFunction layout, GLenum indexType)
+{
+	for (GeometryArena* arena : arenas)
+	{
+		if (arena->layout == layout && arena->vertexSize == vertexSize && arena->indexType == indexType) { return *arena; }
+	}
+
+	arenas.push_back(new GeometryArena(vertexSize, layout, indexType));
+	return *arenas.back();
+}
+
+GeometryArena::GeometryArena(GLsizei vertexSize, LayoutFunction layout, GLenum indexType)
+	: vertexSize(vertexSize), layout(layout), indexType(indexType)
+{
+	indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+	glGenVertexArrays(1, &vao);
+	growVertices(INITIAL_VERTICES);
+	growIndices(INITIAL_INDICES);
+}
+
+GeometryArena::Allocation GeometryArena::Allocate(const void* vertices, size_t vertexCount, const void* indices, size_t indexCount)
+{
+	size_t vertexOffset, indexOffset;
+	if (!vertexRanges.Allocate(vertexCount, vertexOffset))
+	{
+		growVertices(vertexRanges.Capacity() + vertexCount);
+		vertexRanges.Allocate(vertexCount, vertexOffset);
+	}
+	if (!indexRanges.Allocate(indexCount, indexOffset))
+	{
+		growIndices(indexRanges.Capacity() + indexCount);
+		indexRanges.Allocate(indexCount, indexOffset);
+	}
+
+	// uploads go through the copy target so they don't disturb the VAO's bindings
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * vertexSize, vertexCount * vertexSize, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset * indexSize, indexCount * indexSize, indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	Allocation allocation;
+	allocation.baseVertex = (GLint)vertexOffset;
+	allocation.firstIndex = (GLuint)indexOffset;
+	allocation.vertexCount = (GLsizei)vertexCount;
+	allocation.indexCount = (GLsizei)indexCount;
+	return allocation;
+}
+
+void GeometryArena::Free(const Allocation& allocation)
+{
+	vertexRanges.Free(allocation.baseVertex, allocation.vertexCount);
+	indexRanges.Free(allocation.firstIndex, allocation.indexCount);
+}
+
+void GeometryArena::BindInstances(GLuint buffer, GLuint attribute, size_t firstInstance)
+{
+	if (buffer == instanceBuffer && firstInstance == instanceOffset) { return; }
+
+	// a mat4 attribute takes four locations, one per column
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		size_t offset = firstInstance * sizeof(glm::mat4) + column * sizeof(glm::vec4);
+		glVertexAttribPointer(attribute + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)offset);
+		if (instanceBuffer == 0)
+		{
+			glEnableVertexAttribArray(attribute + column);
+			glVertexAttribDivisor(attribute + column, 1);
+		}
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	instanceBuffer = buffer;
+	instanceOffset = firstInstance;
+}
+
+void GeometryArena::growVertices(size_t minimum)
+{
+	// appended space always covers the request, even when the existing free space is fragmented
+	size_t capacity = vertexRanges.Capacity() == 0 ? minimum : vertexRanges.Capacity();
+	while (capacity < minimum) { capacity *= 2; }
+
+	vbo = resizeBuffer(vbo, vertexRanges.Capacity() * vertexSize, capacity * vertexSize);
+	vertexRanges.Grow(capacity);
+
+	// the attribute pointers captured the old buffer
+	GLState::BindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	layout();
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::growIndices(size_t minimum)
+{
+	size_t capacity = indexRanges.Capacity() == 0 ? minimum : indexRanges.Capacity();
+	while (capacity < minimum) { capacity *= 2; }
+
+	ebo = resizeBuffer(ebo, indexRanges.Capacity() * indexSize, capacity * indexSize);
+	indexRanges.Grow(capacity);
+
+	GLState::BindVertexArray(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+}
+
+GLuint GeometryArena::resizeBuffer(GLuint buffer, size_t oldBytes, size_t newBytes)
+{
+	GLuint resized;
+	glGenBuffers(1, &resized);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+	glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+
+	if (buffer != 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return resized;
+}
+
+void GeometryArena::Report(std::ostream& out)
+{
+	for (size_t i = 0; i < arenas.size(); i++)
+	{
+		const GeometryArena& arena = *arenas[i];
+		size_t vertexBytes = arena.vertexRanges.Capacity() * arena.vertexSize;
+		size_t indexBytes = arena.indexRanges.Capacity() * arena.indexSize;
+
+		out << "Geometry arena " << i << " (" << arena.vertexSize << " byte vertices, " << arena.indexSize * 8 << "-bit indices): "
+			<< (vertexBytes + indexBytes) / 1024 << " KiB total, "
+			<< arena.vertexRanges.Used() << "/" << arena.vertexRanges.Capacity() << " vertices, "
+			<< arena.indexRanges.Used() << "/" << arena.indexRanges.Capacity() << " indices, fragmentation "
+			<< arena.vertexRanges.Fragmentation() * 100.0f << "% / " << arena.indexRanges.Fragmentation() * 100.0f << "%" << std::endl;
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <glad/glad.h>
+#include <map>
+#include <ostream>
+#include <vector>
+
+// First-fit free-list allocator over a range of elements. Freed ranges are merged with their neighbours, so the
+// free list only fragments when allocations are released out of order.
+class RangeAllocator
+{
+public:
+	// false when no free range is large enough, the owner is expected to Grow and try again
+	bool Allocate(size_t size, size_t& offset);
+	void Free(size_t offset, size_t size);
+	// appends free space at the end of the range
+	void Grow(size_t newCapacity);
+
+	size_t Capacity() const { return capacity; }
+	size_t Used() const { return used; }
+	size_t LargestFree() const;
+	// 0 when all free space is one range, approaching 1 as it is split into many small ones
+	float Fragmentation() const;
+
+private:
+	std::map<size_t, size_t> freeRanges; // offset -> size
+	size_t capacity = 0;
+	size_t used = 0;
+};
+
+// Shared vertex and index buffers for every mesh with the same vertex layout and index type. Meshes are sub-allocated from two
+// large buffers that sit in one VAO, so consecutive meshes can be drawn without rebinding anything and several of
+// them can go out in a single multi-draw. Indices are stored relative to the mesh, draws pass the base vertex.
+class GeometryArena
+{
+public:
+	// sets the attribute pointers of the layout for the bound VAO and GL_ARRAY_BUFFER
+	typedef void (*LayoutFunction)();
+
+	struct Allocation
+	{
+		GLint baseVertex = 0;
+		GLuint firstIndex = 0;
+		GLsizei vertexCount = 0;
+		GLsizei indexCount = 0;
+	};
+
+	// indexType is GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	static GeometryArena& ForLayout(GLsizei vertexSize, LayoutFunction layout, GLenum indexType);
+
+	// indices are of the arena's index type
+	Allocation Allocate(const void* vertices, size_t vertexCount, const void* indices, size_t indexCount);
+	void Free(const Allocation& allocation);
+
+	GLuint VAO() const { return vao; }
+	GLenum IndexType() const { return indexType; }
+	// byte offset of an index, as glDrawElements expects it
+	const void* IndexOffset(GLuint firstIndex) const { return (const void*)((size_t)firstIndex * indexSize); }
+
+	// points the per-instance mat4 attribute at firstInstance of buffer, expects the VAO to be bound
+	void BindInstances(GLuint buffer, GLuint attribute, size_t firstInstance);
+
+	// capacity, usage and fragmentation of every arena
+	static void Report(std::ostream& out);
+
+private:
+	static const size_t INITIAL_VERTICES = 1 << 16;
+	static const size_t INITIAL_INDICES = 3 << 16;
+
+	static std::vector<GeometryArena*> arenas;
+
+	GLsizei vertexSize;
+	LayoutFunction layout;
+	GLenum indexType;
+	GLsizei indexSize;
+
+	GLuint vao = 0, vbo = 0, ebo = 0;
+	RangeAllocator vertexRanges, indexRanges;
+
+	GLuint instanceBuffer = 0;
+	size_t instanceOffset = (size_t)-1;
+
+	GeometryArena(GLsizei vertexSize, LayoutFunction layout, GLenum indexType);
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	void growVertices(size_t minimum);
+	void growIndices(size_t minimum);
+	static GLuint resizeBuffer(GLuint buffer, size_t oldBytes, size_t newBytes);
+};
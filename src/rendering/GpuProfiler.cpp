@@ -0,0 +1,146 @@
+#include "GpuProfiler.hpp"
+#include "GLExtensions.hpp"
+#include "../core/Profiler.hpp"
+#include <iostream>
+#include <string>
+
+// GL_ARB_pipeline_statistics_query, not part of the generated loader
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB 0x82F0
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+
+bool GpuProfiler::enabled = true;
+std::vector<GpuProfiler::Pass> GpuProfiler::passes;
+GpuProfiler::FrameQueries GpuProfiler::frames[FRAME_LATENCY];
+unsigned int GpuProfiler::frameIndex = 0;
+int GpuProfiler::depth = 0;
+bool GpuProfiler::statistics = false;
+bool GpuProfiler::initialized = false;
+int GpuProfiler::droppedPhase = -1;
+
+void GpuProfiler::Init(bool pipelineStatistics)
+{
+	statistics = pipelineStatistics && GLExtensions::Supported("GL_ARB_pipeline_statistics_query");
+	if (pipelineStatistics && !statistics)
+	{
+		std::cout << "GL_ARB_pipeline_statistics_query is not supported, only timing GPU passes" << std::endl;
+	}
+
+	droppedPhase = Profiler::RegisterPhase("gpu:dropped queries", Profiler::Unit::Count);
+	initialized = true;
+
+	// passes registered before Init didn't know yet whether statistics are available
+	for (Pass& pass : passes)
+	{
+		RegisterStatistics(pass);
+	}
+}
+
+int GpuProfiler::RegisterPass(const char* name)
+{
+	Pass pass;
+	pass.name = std::string("gpu:") + name;
+	pass.timePhase = Profiler::RegisterPhase(pass.name.c_str());
+	pass.vertexPhase = -1;
+	pass.fragmentPhase = -1;
+	RegisterStatistics(pass);
+	passes.push_back(pass);
+
+	return (int)passes.size() - 1;
+}
+
+void GpuProfiler::RegisterStatistics(Pass& pass)
+{
+	if (!statistics || pass.vertexPhase >= 0) { return; }
+
+	pass.vertexPhase = Profiler::RegisterPhase((pass.name + " vertex invocations").c_str(), Profiler::Unit::Count);
+	pass.fragmentPhase = Profiler::RegisterPhase((pass.name + " fragment invocations").c_str(), Profiler::Unit::Count);
+}
+
+void GpuProfiler::BeginFrame()
+{
+	if (!enabled || !initialized) { return; }
+
+	frameIndex++;
+	Collect(frames[frameIndex % FRAME_LATENCY]);
+}
+
+void GpuProfiler::Collect(FrameQueries& frame)
+{
+	for (unsigned int i = 0; i < frame.used; i++)
+	{
+		QuerySet& set = frame.queries[i];
+
+		// never stall: a set with any result that isn't there after FRAME_LATENCY frames is dropped as a whole
+		GLuint available = 0;
+		glGetQueryObjectuiv(set.timer, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available && statistics)
+		{
+			GLuint vertexAvailable = 0, fragmentAvailable = 0;
+			glGetQueryObjectuiv(set.vertexInvocations, GL_QUERY_RESULT_AVAILABLE, &vertexAvailable);
+			glGetQueryObjectuiv(set.fragmentInvocations, GL_QUERY_RESULT_AVAILABLE, &fragmentAvailable);
+			available = vertexAvailable && fragmentAvailable;
+		}
+		if (!available)
+		{
+			Profiler::AddCount(droppedPhase, 1);
+			continue;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(set.timer, GL_QUERY_RESULT, &elapsed);
+		Profiler::AddTime(passes[set.pass].timePhase, std::chrono::nanoseconds(elapsed));
+
+		if (statistics)
+		{
+			GLuint64 vertices = 0, fragments = 0;
+			glGetQueryObjectui64v(set.vertexInvocations, GL_QUERY_RESULT, &vertices);
+			glGetQueryObjectui64v(set.fragmentInvocations, GL_QUERY_RESULT, &fragments);
+			Profiler::AddCount(passes[set.pass].vertexPhase, (double)vertices);
+			Profiler::AddCount(passes[set.pass].fragmentPhase, (double)fragments);
+		}
+	}
+
+	frame.used = 0;
+}
+
+void GpuProfiler::BeginPass(int pass)
+{
+	if (!enabled || !initialized) { return; }
+	if (depth++ > 0) { return; }
+
+	FrameQueries& frame = frames[frameIndex % FRAME_LATENCY];
+	if (frame.used == frame.queries.size())
+	{
+		QuerySet set{};
+		glGenQueries(1, &set.timer);
+		if (statistics)
+		{
+			glGenQueries(1, &set.vertexInvocations);
+			glGenQueries(1, &set.fragmentInvocations);
+		}
+		frame.queries.push_back(set);
+	}
+
+	QuerySet& set = frame.queries[frame.used++];
+	set.pass = pass;
+
+	glBeginQuery(GL_TIME_ELAPSED, set.timer);
+	if (statistics)
+	{
+		glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB, set.vertexInvocations);
+		glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, set.fragmentInvocations);
+	}
+}
+
+void GpuProfiler::EndPass()
+{
+	if (!enabled || !initialized) { return; }
+	if (--depth > 0) { return; }
+
+	glEndQuery(GL_TIME_ELAPSED);
+	if (statistics)
+	{
+		glEndQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB);
+		glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+// Times named render passes on the GPU with GL_TIME_ELAPSED queries and, when GL_ARB_pipeline_statistics_query
+// is available, counts their vertex/fragment shader invocations. Queries are recycled over FRAME_LATENCY frames
+// and only read back once that many frames have passed, so the CPU never waits on the GPU. Results are fed into
+// the Profiler as "gpu:<pass>" phases.
+class GpuProfiler
+{
+public:
+	static const unsigned int FRAME_LATENCY = 3;
+
+	static bool enabled;
+
+	// has to run after the context is created; pipelineStatistics is ignored when the driver lacks the extension
+	static void Init(bool pipelineStatistics);
+	static int RegisterPass(const char* name);
+
+	// reads back the results issued FRAME_LATENCY frames ago and recycles their queries
+	static void BeginFrame();
+
+	// passes can't overlap: a pass begun while another one is running is counted as part of the outer pass
+	static void BeginPass(int pass);
+	static void EndPass();
+
+private:
+	struct Pass
+	{
+		std::string name;
+		int timePhase;
+		int vertexPhase;
+		int fragmentPhase;
+	};
+
+	struct QuerySet
+	{
+		int pass;
+		GLuint timer;
+		GLuint vertexInvocations;
+		GLuint fragmentInvocations;
+	};
+
+	struct FrameQueries
+	{
+		std::vector<QuerySet> queries;
+		unsigned int used = 0;
+	};
+
+	static std::vector<Pass> passes;
+	static FrameQueries frames[FRAME_LATENCY];
+	static unsigned int frameIndex;
+	static int depth;
+	static bool statistics;
+	static bool initialized;
+	static int droppedPhase;
+
+	static void RegisterStatistics(Pass& pass);
+	static void Collect(FrameQueries& frame);
+};
+
+class GpuPassScope
+{
+public:
+	explicit GpuPassScope(int pass) { GpuProfiler::BeginPass(pass); }
+	~GpuPassScope() { GpuProfiler::EndPass(); }
+
+	GpuPassScope(const GpuPassScope&) = delete;
+	GpuPassScope& operator=(const GpuPassScope&) = delete;
+};
+
+#define GPU_PASS_CONCAT_INNER(a, b) a##b
+#define GPU_PASS_CONCAT(a, b) GPU_PASS_CONCAT_INNER(a, b)
+#define GPU_PASS_SCOPE(name) \
+	static const int GPU_PASS_CONCAT(gpuPass_, __LINE__) = GpuProfiler::RegisterPass(name); \
+	GpuPassScope GPU_PASS_CONCAT(gpuPassScope_, __LINE__)(GPU_PASS_CONCAT(gpuPass_, __LINE__))
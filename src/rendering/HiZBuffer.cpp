@@ -0,0 +1,267 @@
+#include "HiZBuffer.hpp"
+#include "Material.hpp"
+#include "GLState.hpp"
+#include "GpuProfiler.hpp"
+#include "../core/Profiler.hpp"
+#include <algorithm>
+#include <cmath>
+
+void HiZBuffer::Init(Mode requested)
+{
+	mode = requested;
+	if (mode == DISABLED) { return; }
+
+	Material::createProgram(downsampleProgram, "assets/shaders/hizVertex.glsl", "assets/shaders/hizDownsampleFragment.glsl");
+	GLState::UseProgram(downsampleProgram);
+	Material::GetUniform<int>(downsampleProgram, "source").Set(0);
+	glGenVertexArrays(1, &emptyVAO);
+
+	if (mode == GPU)
+	{
+		const char* varyings[] = { "visible" };
+		if (Material::createFeedbackProgram(testProgram, "assets/shaders/hizTestVertex.glsl", varyings, 1))
+		{
+			GLState::UseProgram(testProgram);
+			Material::GetUniform<int>(testProgram, "pyramid").Set(0);
+			levelCountUniform = Material::GetUniform<int>(testProgram, "levelCount");
+
+			glGenVertexArrays(1, &testVAO);
+			glGenBuffers(1, &boxBuffer);
+			glGenBuffers(1, &resultBuffer);
+
+			GLState::BindVertexArray(testVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, boxBuffer);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 6, (void*)0);
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 6, (void*)(sizeof(float) * 3));
+			GLState::BindVertexArray(0);
+		}
+		else
+		{
+			std::cout << "ERROR HiZ test program failed, occlusion culling falls back to the CPU" << std::endl;
+			mode = CPU;
+		}
+	}
+}
+
+void HiZBuffer::release()
+{
+	glDeleteFramebuffers(1, &depthFramebuffer);
+	glDeleteFramebuffers(1, &pyramidFramebuffer);
+	glDeleteTextures(1, &depthTexture);
+	glDeleteTextures(1, &pyramidTexture);
+	depthFramebuffer = pyramidFramebuffer = depthTexture = pyramidTexture = 0;
+	GLState::Invalidate();
+}
+
+void HiZBuffer::resize(int newWidth, int newHeight)
+{
+	release();
+	width = newWidth;
+	height = newHeight;
+
+	// same format as the offscreen target's depth and the usual default framebuffer, depth blits have to match
+	glGenTextures(1, &depthTexture);
+	GLState::BindTextureUnit(0, GL_TEXTURE_2D, depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	glGenFramebuffers(1, &depthFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, depthFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+	// level 0 is half resolution, every level halves again down to 1x1
+	int levelWidth = std::max(1, width / 2), levelHeight = std::max(1, height / 2);
+	levelCount = 1 + (int)std::floor(std::log2((float)std::max(levelWidth, levelHeight)));
+
+	glGenTextures(1, &pyramidTexture);
+	GLState::BindTextureUnit(0, GL_TEXTURE_2D, pyramidTexture);
+	cpuLevel = -1;
+	for (int level = 0; level < levelCount; level++)
+	{
+		glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, levelWidth, levelHeight, 0, GL_RED, GL_FLOAT, nullptr);
+		if (cpuLevel < 0 && levelWidth <= CPU_READBACK_WIDTH)
+		{
+			cpuLevel = level;
+			cpuWidth = levelWidth;
+			cpuHeight = levelHeight;
+		}
+		levelWidth = std::max(1, levelWidth / 2);
+		levelHeight = std::max(1, levelHeight / 2);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenFramebuffers(1, &pyramidFramebuffer);
+
+	if (testProgram != 0)
+	{
+		GLState::UseProgram(testProgram);
+		levelCountUniform.Set(levelCount);
+	}
+}
+
+void HiZBuffer::Build(GLuint sourceFramebuffer, int newWidth, int newHeight, const glm::mat4& newViewProjection)
+{
+	built = false;
+	if (mode == DISABLED) { return; }
+
+	PROFILE_SCOPE("HiZBuffer::Build");
+	GPU_PASS_SCOPE("hiz build");
+
+	if (newWidth != width || newHeight != height) { resize(newWidth, newHeight); }
+	viewProjection = newViewProjection;
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFramebuffer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	GLState::Disable(GL_DEPTH_TEST);
+	GLState::Disable(GL_BLEND);
+	GLState::Disable(GL_CULL_FACE);
+	GLState::UseProgram(downsampleProgram);
+	GLState::BindVertexArray(emptyVAO);
+	glBindFramebuffer(GL_FRAMEBUFFER, pyramidFramebuffer);
+
+	int levelWidth = std::max(1, width / 2), levelHeight = std::max(1, height / 2);
+	for (int level = 0; level < levelCount; level++)
+	{
+		// level 0 reduces the depth copy, every other level the one above it. Limiting the pyramid to that
+		// single level while it is read keeps the texture out of a feedback loop with its own render target
+		if (level == 0)
+		{
+			GLState::BindTextureUnit(0, GL_TEXTURE_2D, depthTexture);
+		}
+		else
+		{
+			GLState::BindTextureUnit(0, GL_TEXTURE_2D, pyramidTexture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+		}
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramidTexture, level);
+		glViewport(0, 0, levelWidth, levelHeight);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		levelWidth = std::max(1, levelWidth / 2);
+		levelHeight = std::max(1, levelHeight / 2);
+	}
+
+	GLState::BindTextureUnit(0, GL_TEXTURE_2D, pyramidTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+	if (mode == CPU)
+	{
+		cpuDepth.resize((size_t)cpuWidth * cpuHeight);
+		glGetTexImage(GL_TEXTURE_2D, cpuLevel, GL_RED, GL_FLOAT, cpuDepth.data());
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, sourceFramebuffer);
+	glViewport(0, 0, width, height);
+	built = true;
+}
+
+size_t HiZBuffer::Test(const AABB* boxes, size_t count, unsigned char* visible)
+{
+	if (!built || count == 0) { return 0; }
+
+	PROFILE_SCOPE("HiZBuffer::Test");
+
+	size_t occluded = 0;
+	if (mode == GPU)
+	{
+		testOnGpu(boxes, count);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (visible[i] && results[i] == 0.0f) { visible[i] = 0; occluded++; }
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (visible[i] && occludedOnCpu(boxes[i])) { visible[i] = 0; occluded++; }
+		}
+	}
+	return occluded;
+}
+
+void HiZBuffer::testOnGpu(const AABB* boxes, size_t count)
+{
+	boxData.resize(count * 6);
+	for (size_t i = 0; i < count; i++)
+	{
+		float* box = &boxData[i * 6];
+		box[0] = boxes[i].min.x; box[1] = boxes[i].min.y; box[2] = boxes[i].min.z;
+		box[3] = boxes[i].max.x; box[4] = boxes[i].max.y; box[5] = boxes[i].max.z;
+	}
+
+	if (count > boxCapacity)
+	{
+		boxCapacity = 1;
+		while (boxCapacity < count) { boxCapacity <<= 1; }
+
+		glBindBuffer(GL_ARRAY_BUFFER, boxBuffer);
+		glBufferData(GL_ARRAY_BUFFER, boxCapacity * sizeof(float) * 6, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, resultBuffer);
+		glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, boxCapacity * sizeof(float), nullptr, GL_STREAM_READ);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, boxBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(float) * 6, boxData.data());
+
+	GLState::UseProgram(testProgram);
+	GLState::BindTextureUnit(0, GL_TEXTURE_2D, pyramidTexture);
+	GLState::BindVertexArray(testVAO);
+
+	GLState::Enable(GL_RASTERIZER_DISCARD);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, resultBuffer);
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+	glEndTransformFeedback();
+	GLState::Disable(GL_RASTERIZER_DISCARD);
+
+	// the draw list for this frame depends on it, so this waits for the terrain, the pyramid and the test
+	results.resize(count);
+	glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, count * sizeof(float), results.data());
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+}
+
+bool HiZBuffer::occludedOnCpu(const AABB& box) const
+{
+	// same projection as hizTestVertex.glsl
+	glm::vec2 rectMin(1.0f), rectMax(0.0f);
+	float nearest = 1.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+		glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+		if (clip.w <= 0.0f) { return false; }
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		rectMin = glm::min(rectMin, glm::vec2(ndc.x, ndc.y) * 0.5f + 0.5f);
+		rectMax = glm::max(rectMax, glm::vec2(ndc.x, ndc.y) * 0.5f + 0.5f);
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+	rectMin = glm::clamp(rectMin, 0.0f, 1.0f);
+	rectMax = glm::clamp(rectMax, 0.0f, 1.0f);
+
+	// the level is small enough to take the farthest depth of every texel under the rectangle
+	int lowX = std::min((int)(rectMin.x * cpuWidth), cpuWidth - 1), highX = std::min((int)(rectMax.x * cpuWidth), cpuWidth - 1);
+	int lowY = std::min((int)(rectMin.y * cpuHeight), cpuHeight - 1), highY = std::min((int)(rectMax.y * cpuHeight), cpuHeight - 1);
+	float farthest = 0.0f;
+	for (int y = lowY; y <= highY; y++)
+	{
+		for (int x = lowX; x <= highX; x++)
+		{
+			farthest = std::max(farthest, cpuDepth[(size_t)y * cpuWidth + x]);
+		}
+	}
+	return nearest > farthest;
+}
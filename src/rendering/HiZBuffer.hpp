@@ -0,0 +1,63 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Bounds.hpp"
+#include "IOcclusionTest.hpp"
+#include "Uniform.hpp"
+
+// Hierarchical depth buffer for occlusion culling. Build copies the depth of what has been drawn so far (the
+// terrain) and reduces it into a mip chain where every texel holds the farthest depth below it. Test projects
+// world boxes and compares their nearest depth with the farthest depth of the pyramid texels they cover.
+// The test runs in a vertex shader over one point per box with the results captured through transform feedback;
+// when that program doesn't link, or the CPU path is forced, one coarse level is read back and tested on the CPU.
+// Both paths read their results in the same frame, so occluders have to be drawn before Build.
+class HiZBuffer : public IOcclusionTest
+{
+public:
+	enum Mode { DISABLED, GPU, CPU };
+
+	// widest level the CPU path reads back
+	static const int CPU_READBACK_WIDTH = 160;
+
+	// needs a current context, GPU falls back to CPU when the test program can't be built
+	void Init(Mode mode);
+	Mode GetMode() const { return mode; }
+
+	// reduces the depth attachment of sourceFramebuffer, which is bound again afterwards
+	void Build(GLuint sourceFramebuffer, int width, int height, const glm::mat4& viewProjection);
+	// sets visible[i] to 0 for every box hidden behind the pyramid, returns how many were
+	size_t Test(const AABB* boxes, size_t count, unsigned char* visible) override;
+
+private:
+	Mode mode = DISABLED;
+	bool built = false;
+
+	int width = 0, height = 0;
+	int levelCount = 0;
+	GLuint depthTexture = 0;
+	GLuint depthFramebuffer = 0;
+	GLuint pyramidTexture = 0;
+	GLuint pyramidFramebuffer = 0;
+	GLuint emptyVAO = 0;
+	GLuint downsampleProgram = 0;
+
+	GLuint testProgram = 0;
+	Uniform<int> levelCountUniform;
+	GLuint testVAO = 0;
+	GLuint boxBuffer = 0;
+	GLuint resultBuffer = 0;
+	size_t boxCapacity = 0;
+	std::vector<float> boxData;
+	std::vector<float> results;
+
+	glm::mat4 viewProjection;
+	int cpuLevel = 0;
+	int cpuWidth = 0, cpuHeight = 0;
+	std::vector<float> cpuDepth;
+
+	void resize(int newWidth, int newHeight);
+	void release();
+	bool occludedOnCpu(const AABB& box) const;
+	void testOnGpu(const AABB* boxes, size_t count);
+};
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+#include "Bounds.hpp"
+
+// Anything SceneCuller can ask whether world boxes are hidden behind what has been drawn or rasterized this frame.
+class IOcclusionTest
+{
+public:
+	virtual ~IOcclusionTest() {}
+
+	// sets visible[i] to 0 for every visible box that is hidden, returns how many were
+	virtual size_t Test(const AABB* boxes, size_t count, unsigned char* visible) = 0;
+};
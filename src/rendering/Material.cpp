@@ -1,79 +1,192 @@
 #include "Material.hpp"
 #include "../core/File.hpp"
 #include <iostream>
+#include <sstream>
 #include "../core/Debug.hpp"
+#include "GLState.hpp"
+#include "FrameData.hpp"
+#include "mesh.hpp"
+
+std::unordered_map<GLuint, std::unordered_map<std::string, Material::UniformInfo>> Material::uniformTables;
+
+// sampler per TextureSlot, in slot order
+static const char* slotSamplers[SLOT_COUNT] = {
+    "texture_diffuse1",
+    "texture_specular1",
+    "texture_normal1",
+    "texture_roughness1",
+    "texture_ao1",
+    "texture_height1"
+};
 
 Material::Material(const char* vertexShaderPath, const char* fragmentShaderPath)
 {
     createProgram(shaderProgram, vertexShaderPath, fragmentShaderPath);
-    glUseProgram(shaderProgram);
+    GLState::UseProgram(shaderProgram);
 
-    glUniform1i(glGetUniformLocation(shaderProgram, "texture_diffuse1"), 0);
-    glUniform1i(glGetUniformLocation(shaderProgram, "texture_specular1"), 1);
-    glUniform1i(glGetUniformLocation(shaderProgram, "texture_normal1"), 2);
-    glUniform1i(glGetUniformLocation(shaderProgram, "texture_roughness1"), 3);
-    glUniform1i(glGetUniformLocation(shaderProgram, "texture_ao1"), 4);
+    for (int slot = 0; slot < SLOT_COUNT; slot++)
+    {
+        GetUniform<int>(slotSamplers[slot]).Set(slot);
+    }
+}
+
+Material::~Material()
+{
+    for (const MaterialTexture& texture : textures)
+        MaterialTexture::releaseTexture(texture.id);
 }
 
 void Material::createProgram(GLuint& programID, const char* vertexShaderPath, const char* fragmentShaderPath)
 {
-	char* vertexSource;
-	char* fragmentSource;
+	Debug::Log("Create Program");
 
-	File::LoadFile(vertexShaderPath, vertexSource);
-	File::LoadFile(fragmentShaderPath, fragmentSource);
+	GLuint vertexShaderID = compileShader(GL_VERTEX_SHADER, vertexShaderPath);
+	GLuint framgentShaderID = compileShader(GL_FRAGMENT_SHADER, fragmentShaderPath);
 
-	int succes;
-	char infoLog[512];
+	programID = glCreateProgram();
+	glAttachShader(programID, vertexShaderID);
+	glAttachShader(programID, framgentShaderID);
+	linkProgram(programID);
 
-	Debug::Log("Create Program");
+	glDeleteShader(vertexShaderID);
+	glDeleteShader(framgentShaderID);
 
-	GLuint vertexShaderID, framgentShaderID;
+	FrameData::BindBlock(programID);
+	reflectProgram(programID);
+}
 
-	vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShaderID, 1, &vertexSource, nullptr);
-	glCompileShader(vertexShaderID);
+bool Material::createFeedbackProgram(GLuint& programID, const char* vertexShaderPath, const char* const* varyings, int varyingCount)
+{
+	Debug::Log("Create Feedback Program");
 
-	glGetShaderiv(vertexShaderID, GL_COMPILE_STATUS, &succes);
-	if (!succes)
-	{
-		glGetShaderInfoLog(vertexShaderID, 512, nullptr, infoLog);
-		std::cout << "ERROR Compiling vertex shader" << infoLog << std::endl;
-	}
+	GLuint vertexShaderID = compileShader(GL_VERTEX_SHADER, vertexShaderPath);
+
+	programID = glCreateProgram();
+	glAttachShader(programID, vertexShaderID);
+	glTransformFeedbackVaryings(programID, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+	bool linked = linkProgram(programID);
+
+	glDeleteShader(vertexShaderID);
 
-	framgentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(framgentShaderID, 1, &fragmentSource, nullptr);
-	glCompileShader(framgentShaderID);
+	FrameData::BindBlock(programID);
+	reflectProgram(programID);
+	return linked;
+}
 
+GLuint Material::compileShader(GLenum type, const char* path)
+{
+	std::string sourceString;
+	loadShaderSource(path, sourceString);
+	const char* source = sourceString.c_str();
 
-	glGetShaderiv(framgentShaderID, GL_COMPILE_STATUS, &succes);
+	int succes;
+	char infoLog[512];
+
+	GLuint shaderID = glCreateShader(type);
+	glShaderSource(shaderID, 1, &source, nullptr);
+	glCompileShader(shaderID);
+
+	glGetShaderiv(shaderID, GL_COMPILE_STATUS, &succes);
 	if (!succes)
 	{
-		glGetShaderInfoLog(framgentShaderID, 512, nullptr, infoLog);
-		std::cout << "ERROR Compiling fragment shader" << infoLog << std::endl;
+		glGetShaderInfoLog(shaderID, 512, nullptr, infoLog);
+		std::cout << "ERROR Compiling " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader " << path << infoLog << std::endl;
 	}
+	return shaderID;
+}
 
-	programID = glCreateProgram();
-	glAttachShader(programID, vertexShaderID);
-	glAttachShader(programID, framgentShaderID);
-	glLinkProgram(programID);
+bool Material::linkProgram(GLuint programID)
+{
+	int succes;
+	char infoLog[512];
 
+	glLinkProgram(programID);
 	glGetProgramiv(programID, GL_LINK_STATUS, &succes);
 	if (!succes)
 	{
 		glGetProgramInfoLog(programID, 512, nullptr, infoLog);
 		std::cout << "ERROR Linking shader program" << infoLog << std::endl;
 	}
+	return succes != 0;
+}
 
-	glDeleteShader(vertexShaderID);
-	glDeleteShader(framgentShaderID);
+bool Material::loadShaderSource(const char* path, std::string& source, int depth)
+{
+	if (depth > MAX_INCLUDE_DEPTH)
+	{
+		std::cout << "ERROR Shader includes nested too deep at " << path << std::endl;
+		return false;
+	}
 
-	delete vertexSource;
-	delete fragmentSource;
+	char* fileSource;
+	File::LoadFile(path, fileSource);
+	if (fileSource == NULL)
+	{
+		std::cout << "ERROR Could not open shader " << path << std::endl;
+		return false;
+	}
+
+	// includes are resolved relative to the directory of the including file
+	std::string directory(path);
+	size_t slash = directory.find_last_of("/\\");
+	directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+
+	std::istringstream stream(fileSource);
+	delete[] fileSource;
+
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		size_t directive = line.find("#include");
+		size_t open = line.find('"');
+		size_t close = line.rfind('"');
+		if (directive == line.find_first_not_of(" \t") && directive != std::string::npos && open != close)
+		{
+			std::string includePath = directory + line.substr(open + 1, close - open - 1);
+			if (!loadShaderSource(includePath.c_str(), source, depth + 1)) { return false; }
+			source += '\n';
+			continue;
+		}
+
+		source += line;
+		source += '\n';
+	}
+	return true;
+}
+
+void Material::reflectProgram(GLuint programID)
+{
+	std::unordered_map<std::string, UniformInfo>& table = uniformTables[programID];
+	table.clear();
+
+	GLint count = 0, maxNameLength = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> name(maxNameLength > 0 ? maxNameLength : 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		UniformInfo info;
+		glGetActiveUniform(programID, (GLuint)i, (GLsizei)name.size(), &length, &info.size, &info.type, name.data());
+
+		// members of uniform blocks have no location
+		info.location = glGetUniformLocation(programID, name.data());
+		if (info.location < 0) { continue; }
+
+		// arrays are reported as "name[0]", register them under their plain name as well
+		std::string uniformName(name.data(), length);
+		table[uniformName] = info;
+		size_t bracket = uniformName.find('[');
+		if (bracket != std::string::npos)
+		{
+			table[uniformName.substr(0, bracket)] = info;
+		}
+	}
 }
 
 void Material::Use() const {
-    glUseProgram(shaderProgram);
+    GLState::UseProgram(shaderProgram);
 
     //for (GLint i = 0; i < textures.size(); ++i) {
     //    glActiveTexture(GL_TEXTURE0 + i);
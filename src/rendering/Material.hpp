@@ -1,7 +1,11 @@
 #pragma once
 
+#include <iostream>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include "MaterialTexture.hpp"
+#include "Uniform.hpp"
 
 class Material {
 public:
@@ -9,7 +13,57 @@ public:
     std::vector<MaterialTexture> textures;
 
     Material(const char* vertexShaderPath, const char* fragmentShaderPath);
+    // releases the textures
+    ~Material();
+    Material(const Material&) = delete;
+    Material& operator=(const Material&) = delete;
     static void createProgram(GLuint& programID, const char* vertexShaderPath, const char* fragmentShaderPath);
+    // vertex shader only program whose outputs are captured with transform feedback, returns whether it linked
+    static bool createFeedbackProgram(GLuint& programID, const char* vertexShaderPath, const char* const* varyings, int varyingCount);
+
+    // resolves a uniform from the table built when the program was linked, meant to be called once at setup
+    template <typename T>
+    static Uniform<T> GetUniform(GLuint program, const char* name);
+    template <typename T>
+    Uniform<T> GetUniform(const char* name) const { return GetUniform<T>(shaderProgram, name); }
 
     void Use() const;
-};
\ No newline at end of file
+
+private:
+    struct UniformInfo {
+        GLint location;
+        GLenum type;
+        GLint size;
+    };
+
+    // active uniforms of every linked program, filled once by reflectProgram
+    static std::unordered_map<GLuint, std::unordered_map<std::string, UniformInfo>> uniformTables;
+    static void reflectProgram(GLuint programID);
+    static GLuint compileShader(GLenum type, const char* path);
+    static bool linkProgram(GLuint programID);
+
+    // reads a shader and splices in the files it #includes, GLSL 330 has no include directive of its own
+    static const int MAX_INCLUDE_DEPTH = 8;
+    static bool loadShaderSource(const char* path, std::string& source, int depth = 0);
+};
+
+template <typename T>
+Uniform<T> Material::GetUniform(GLuint program, const char* name)
+{
+    Uniform<T> uniform;
+
+    auto table = uniformTables.find(program);
+    if (table == uniformTables.end()) { return uniform; }
+
+    auto info = table->second.find(name);
+    if (info == table->second.end()) { return uniform; }
+
+    if (!UniformTypeMatches<T>(info->second.type))
+    {
+        std::cout << "ERROR Uniform " << name << " has a different type than requested" << std::endl;
+        return uniform;
+    }
+
+    uniform.location = info->second.location;
+    return uniform;
+}
\ No newline at end of file
@@ -1,46 +1,17 @@
 #include "MaterialTexture.hpp"
-#include "../../stb_image.h"
-#include <iostream>
+#include "TextureRegistry.hpp"
 
 MaterialTexture::MaterialTexture(const char* path, const char* type) : path(path), type(type)
 {
 	id = loadTexture(path);
 }
 
-GLuint MaterialTexture::loadTexture(const char* path, int comp)
+GLuint MaterialTexture::loadTexture(const char* path, TextureCache::Kind kind, const void* owner)
 {
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	int width, height, numChannels;
-	unsigned char* data = stbi_load(path, &width, &height, &numChannels, comp);
-
-	if (data)
-	{
-		if (comp != 0) { numChannels = comp; }
-
-		if (numChannels == 3)
-		{
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		}
-		else if (numChannels == 4)
-		{
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		}
-
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
-	{
-		std::cout << "Error loading texture: " << path << std::endl;
-	}
-
-	stbi_image_free(data);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	return TextureRegistry::Acquire(path, kind, owner);
+}
 
-	return textureID;
+void MaterialTexture::releaseTexture(GLuint id)
+{
+	TextureRegistry::Release(id);
 }
\ No newline at end of file
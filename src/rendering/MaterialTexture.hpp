@@ -2,11 +2,14 @@
 
 #include <string>
 #include <glad/glad.h>
+#include "TextureCache.hpp"
 
 struct MaterialTexture {
     GLuint id;
     std::string type;
     std::string path;
     MaterialTexture(const char* path, const char* type);
-    GLuint loadTexture(const char* path, int comp = 0);
+    // every loadTexture holds a TextureRegistry reference, releaseTexture gives it back
+    static GLuint loadTexture(const char* path, TextureCache::Kind kind = TextureCache::COLOR, const void* owner = nullptr);
+    static void releaseTexture(GLuint id);
 };
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include "MeshCache.hpp"
+#include "../core/File.hpp"
+#include "MeshOptimizer.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+const char* const MeshCache::CACHE_DIRECTORY = "cache/meshes";
+const uint32_t MeshCache::MAGIC = 0x48534D47; // "GMSH"
+const uint32_t MeshCache::VERSION = 1;
+
+bool MeshCache::enabled = true;
+std::vector<MeshCache::LoadRecord> MeshCache::loads;
+
+MeshCache::Writer::Writer(const PositionQuantization& quantization)
+{
+	FileHeader header = {};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.quantizationOrigin[0] = quantization.origin.x;
+	header.quantizationOrigin[1] = quantization.origin.y;
+	header.quantizationOrigin[2] = quantization.origin.z;
+	header.quantizationSize = quantization.size;
+	append(&header, sizeof(header));
+}
+
+void MeshCache::Writer::Add(const MeshGeometry& geometry, const AABB& bounds, const BoundingSphere& sphere, const std::vector<TextureReference>& textures)
+{
+	std::string strings;
+	for (const TextureReference& texture : textures)
+	{
+		strings.append(texture.type.c_str(), texture.type.size() + 1);
+		strings.append(texture.path.c_str(), texture.path.size() + 1);
+	}
+
+	MeshHeader header = {};
+	header.vertexCount = (uint32_t)geometry.vertexCount;
+	header.indexCount = (uint32_t)geometry.indexCount;
+	header.indexType = (uint32_t)geometry.indexType;
+	header.lodCount = (uint32_t)geometry.lods.size();
+	for (int i = 0; i < 3; i++)
+	{
+		header.boundsMin[i] = bounds.min[i];
+		header.boundsMax[i] = bounds.max[i];
+		header.sphereCenter[i] = sphere.center[i];
+	}
+	header.sphereRadius = sphere.radius;
+	header.textureCount = (uint32_t)textures.size();
+	header.stringBytes = (uint32_t)strings.size();
+
+	append(&header, sizeof(header));
+	append(geometry.lods.data(), geometry.lods.size() * sizeof(MeshLod));
+	append(strings.data(), strings.size());
+	align();
+	append(geometry.vertices, geometry.vertexCount * sizeof(PackedVertex));
+	align();
+	append(geometry.indices, geometry.indexCount * (geometry.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int)));
+	align();
+
+	meshCount++;
+}
+
+bool MeshCache::Writer::Save(uint64_t key) const
+{
+	std::vector<unsigned char> output = data;
+	FileHeader header;
+	std::memcpy(&header, output.data(), sizeof(header));
+	header.key = key;
+	header.meshCount = meshCount;
+	std::memcpy(output.data(), &header, sizeof(header));
+
+	File::CreateDirectories(CACHE_DIRECTORY);
+	return File::WriteAtomic(cachePath(key).c_str(), output.data(), output.size());
+}
+
+void MeshCache::Writer::append(const void* bytes, size_t size)
+{
+	const unsigned char* begin = (const unsigned char*)bytes;
+	data.insert(data.end(), begin, begin + size);
+}
+
+void MeshCache::Writer::align()
+{
+	data.resize((data.size() + 7) & ~(size_t)7, 0);
+}
+
+uint64_t MeshCache::Key(const std::string& path, unsigned int importFlags)
+{
+	std::vector<unsigned char> source;
+	if (!readFile(path, source)) { return 0; }
+
+	// anything that changes the cached result goes into the key next to the source bytes
+	uint64_t settings[4] = { VERSION, importFlags, MeshOptimizer::Enabled() ? 1u : 0u, sizeof(PackedVertex) * 16 + Mesh::MAX_LODS };
+	std::vector<unsigned char> settingBytes((const unsigned char*)settings, (const unsigned char*)settings + sizeof(settings));
+	uint64_t key = hash(source, hash(settingBytes, 14695981039346656037ull));
+
+	// an .obj takes its materials, and with them the texture references, from the .mtl files it names
+	if (path.size() > 4 && path.compare(path.size() - 4, 4, ".obj") == 0)
+	{
+		std::string directory = path.substr(0, path.find_last_of('/') + 1);
+		std::istringstream lines(std::string(source.begin(), source.end()));
+		std::string line;
+		while (std::getline(lines, line))
+		{
+			if (line.compare(0, 7, "mtllib ") != 0) { continue; }
+
+			std::string name = line.substr(7);
+			while (!name.empty() && (name.back() == '\r' || name.back() == ' ')) { name.pop_back(); }
+
+			std::vector<unsigned char> material;
+			if (readFile(directory + name, material)) { key = hash(material, key); }
+		}
+	}
+
+	return key != 0 ? key : 1;
+}
+
+bool MeshCache::Open(uint64_t key)
+{
+	entries.clear();
+	if (!file.Open(cachePath(key).c_str())) { return false; }
+
+	const unsigned char* data = file.Data();
+	size_t size = file.Size();
+	size_t offset = sizeof(FileHeader);
+
+	FileHeader header;
+	if (size < sizeof(header)) { file.Close(); return false; }
+	std::memcpy(&header, data, sizeof(header));
+	if (header.magic != MAGIC || header.version != VERSION || header.key != key)
+	{
+		file.Close();
+		return false;
+	}
+
+	quantization.origin = glm::vec3(header.quantizationOrigin[0], header.quantizationOrigin[1], header.quantizationOrigin[2]);
+	quantization.size = header.quantizationSize;
+
+	for (uint32_t m = 0; m < header.meshCount; m++)
+	{
+		MeshHeader mesh;
+		if (offset + sizeof(mesh) > size) { break; }
+		std::memcpy(&mesh, data + offset, sizeof(mesh));
+		offset += sizeof(mesh);
+
+		// a stale or corrupt file must not draw outside its arena allocation
+		if (mesh.indexType != GL_UNSIGNED_SHORT && mesh.indexType != GL_UNSIGNED_INT) { break; }
+		if (mesh.lodCount == 0 || mesh.lodCount > Mesh::MAX_LODS) { break; }
+
+		size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+		size_t lodBytes = (size_t)mesh.lodCount * sizeof(MeshLod);
+		size_t vertexBytes = (size_t)mesh.vertexCount * sizeof(PackedVertex);
+		size_t indexBytes = (size_t)mesh.indexCount * indexSize;
+		if (offset + lodBytes + mesh.stringBytes > size) { break; }
+
+		Entry entry;
+		entry.geometry.lods.resize(mesh.lodCount);
+		std::memcpy(entry.geometry.lods.data(), data + offset, lodBytes);
+		offset += lodBytes;
+
+		bool lodsValid = true;
+		for (const MeshLod& lod : entry.geometry.lods)
+		{
+			lodsValid = lodsValid && lod.indexCount >= 0 && lod.firstIndex <= mesh.indexCount
+				&& (size_t)lod.indexCount <= (size_t)mesh.indexCount - lod.firstIndex;
+		}
+		if (!lodsValid) { break; }
+
+		const char* strings = (const char*)data + offset;
+		const char* stringsEnd = strings + mesh.stringBytes;
+		offset = (offset + mesh.stringBytes + 7) & ~(size_t)7;
+		for (uint32_t t = 0; t < mesh.textureCount && strings < stringsEnd; t++)
+		{
+			TextureReference texture;
+			texture.type = std::string(strings, strnlen(strings, stringsEnd - strings));
+			strings += texture.type.size() + 1;
+			if (strings >= stringsEnd) { break; }
+			texture.path = std::string(strings, strnlen(strings, stringsEnd - strings));
+			strings += texture.path.size() + 1;
+			entry.textures.push_back(texture);
+		}
+
+		if (offset + vertexBytes > size) { break; }
+		entry.geometry.vertices = (const PackedVertex*)(data + offset);
+		entry.geometry.vertexCount = mesh.vertexCount;
+		offset = (offset + vertexBytes + 7) & ~(size_t)7;
+
+		if (offset + indexBytes > size) { break; }
+		// base vertex draws would read another mesh's vertices or past the buffer, one pass over the mapped indices
+		bool indicesValid = true;
+		if (mesh.indexType == GL_UNSIGNED_SHORT)
+		{
+			const unsigned short* indices = (const unsigned short*)(data + offset);
+			for (uint32_t i = 0; i < mesh.indexCount; i++) { indicesValid = indicesValid && indices[i] < mesh.vertexCount; }
+		}
+		else
+		{
+			const uint32_t* indices = (const uint32_t*)(data + offset);
+			for (uint32_t i = 0; i < mesh.indexCount; i++) { indicesValid = indicesValid && indices[i] < mesh.vertexCount; }
+		}
+		if (!indicesValid) { break; }
+		entry.geometry.indices = data + offset;
+		entry.geometry.indexCount = mesh.indexCount;
+		entry.geometry.indexType = (GLenum)mesh.indexType;
+		offset = (offset + indexBytes + 7) & ~(size_t)7;
+
+		entry.bounds.min = glm::vec3(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+		entry.bounds.max = glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]);
+		entry.sphere.center = glm::vec3(mesh.sphereCenter[0], mesh.sphereCenter[1], mesh.sphereCenter[2]);
+		entry.sphere.radius = mesh.sphereRadius;
+		entries.push_back(entry);
+	}
+
+	// a file cut short or failing the checks is a miss, the model is imported again and overwrites it
+	if (entries.size() != header.meshCount)
+	{
+		entries.clear();
+		file.Close();
+		return false;
+	}
+	return true;
+}
+
+void MeshCache::RecordLoad(const std::string& path, bool cached, double milliseconds)
+{
+	LoadRecord record = { path, cached, milliseconds };
+	loads.push_back(record);
+}
+
+void MeshCache::Report(std::ostream& out)
+{
+	for (const LoadRecord& record : loads)
+	{
+		out << "Model load: " << record.path << (record.cached ? " from the mesh cache in " : " imported in ")
+			<< record.milliseconds << " ms" << std::endl;
+	}
+}
+
+std::string MeshCache::cachePath(uint64_t key)
+{
+	char fileName[32];
+	std::snprintf(fileName, sizeof(fileName), "/%016llx.gmsh", (unsigned long long)key);
+	return std::string(CACHE_DIRECTORY) + fileName;
+}
+
+uint64_t MeshCache::hash(const std::vector<unsigned char>& data, uint64_t seed)
+{
+	// FNV-1a over 64-bit words, models are large enough for byte steps to show up in the warm start
+	uint64_t result = seed;
+	size_t words = data.size() / 8;
+	for (size_t i = 0; i < words; i++)
+	{
+		uint64_t word;
+		std::memcpy(&word, data.data() + i * 8, 8);
+		result ^= word;
+		result *= 1099511628211ull;
+	}
+	for (size_t i = words * 8; i < data.size(); i++)
+	{
+		result ^= data[i];
+		result *= 1099511628211ull;
+	}
+	return result;
+}
+
+bool MeshCache::readFile(const std::string& path, std::vector<unsigned char>& output)
+{
+	std::ifstream stream(path, std::ios::binary | std::ios::ate);
+	if (!stream) { return false; }
+
+	std::streamsize size = stream.tellg();
+	if (size <= 0) { return false; }
+	stream.seekg(0, std::ios::beg);
+
+	output.resize((size_t)size);
+	return (bool)stream.read((char*)output.data(), size);
+}
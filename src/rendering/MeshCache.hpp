@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "../core/MappedFile.hpp"
+#include "mesh.hpp"
+
+// Binary cache of imported models in CACHE_DIRECTORY, so a warm start skips Assimp and every per-vertex step after
+// it. A file holds the model's quantization and per mesh the packed vertices, the index lists of all levels of
+// detail, the bounds and the textures its material references. Files are named after a hash of the model file,
+// the .mtl files an .obj names, the import flags and everything that changes the packed result. Other files a
+// format pulls in are not part of the key, delete the directory after changing them.
+class MeshCache
+{
+public:
+	struct TextureReference
+	{
+		// texture_<type> name the shaders sample it as
+		std::string type;
+		// as the material names it, relative to the model's directory
+		std::string path;
+	};
+
+	struct Entry
+	{
+		// points into the mapped file while it is open
+		MeshGeometry geometry;
+		AABB bounds;
+		BoundingSphere sphere;
+		std::vector<TextureReference> textures;
+	};
+
+	// collects the meshes of one import, Save writes them as a single file
+	class Writer
+	{
+	public:
+		explicit Writer(const PositionQuantization& quantization);
+
+		void Add(const MeshGeometry& geometry, const AABB& bounds, const BoundingSphere& sphere, const std::vector<TextureReference>& textures);
+		bool Save(uint64_t key) const;
+
+	private:
+		std::vector<unsigned char> data;
+		uint32_t meshCount = 0;
+
+		void append(const void* bytes, size_t size);
+		// the blobs start 8 byte aligned, the mapping can be read in place
+		void align();
+	};
+
+	// 0 when the model file can't be read
+	static uint64_t Key(const std::string& path, unsigned int importFlags);
+
+	// maps the file of key, false on a miss or a file that doesn't match
+	bool Open(uint64_t key);
+	const PositionQuantization& Quantization() const { return quantization; }
+	const std::vector<Entry>& Entries() const { return entries; }
+
+	static void SetEnabled(bool enabled) { MeshCache::enabled = enabled; }
+	static bool Enabled() { return enabled; }
+	// Model reports every load, the report lists them with their time
+	static void RecordLoad(const std::string& path, bool cached, double milliseconds);
+	static void Report(std::ostream& out);
+
+private:
+	static const char* const CACHE_DIRECTORY;
+	static const uint32_t MAGIC;
+	// bump whenever the file layout or anything that builds MeshGeometry changes
+	static const uint32_t VERSION;
+
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		float quantizationOrigin[3];
+		float quantizationSize;
+		uint32_t meshCount;
+		uint32_t padding;
+	};
+
+	// followed by the lods, the texture strings and then the vertex and index blobs, each 8 byte aligned
+	struct MeshHeader
+	{
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexType;
+		uint32_t lodCount;
+		float boundsMin[3];
+		float boundsMax[3];
+		float sphereCenter[3];
+		float sphereRadius;
+		uint32_t textureCount;
+		// type and path of every texture, each zero terminated
+		uint32_t stringBytes;
+	};
+
+	struct LoadRecord
+	{
+		std::string path;
+		bool cached;
+		double milliseconds;
+	};
+
+	MappedFile file;
+	PositionQuantization quantization;
+	std::vector<Entry> entries;
+
+	static std::string cachePath(uint64_t key);
+	static uint64_t hash(const std::vector<unsigned char>& data, uint64_t seed);
+	static bool readFile(const std::string& path, std::vector<unsigned char>& output);
+
+	static bool enabled;
+	static std::vector<LoadRecord> loads;
+};
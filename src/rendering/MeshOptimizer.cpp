@@ -0,0 +1,384 @@
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Forsyth's constants, recently used vertices score high and so do vertices with few triangles left
+const float MeshOptimizer::CACHE_DECAY_POWER = 1.5f;
+const float MeshOptimizer::LAST_TRIANGLE_SCORE = 0.75f;
+const float MeshOptimizer::VALENCE_BOOST_SCALE = 2.0f;
+const float MeshOptimizer::VALENCE_BOOST_POWER = 0.5f;
+// a cluster may cost 5% more cache misses than the order it was cut from
+const float MeshOptimizer::OVERDRAW_THRESHOLD = 1.05f;
+
+bool MeshOptimizer::enabled = true;
+size_t MeshOptimizer::meshCount = 0;
+size_t MeshOptimizer::importedVertices = 0;
+MeshOptimizer::Statistics MeshOptimizer::totalBefore;
+MeshOptimizer::Statistics MeshOptimizer::totalAfter;
+double MeshOptimizer::totalMilliseconds = 0.0;
+
+void MeshOptimizer::Statistics::Add(const Statistics& other)
+{
+	triangles += other.triangles;
+	vertices += other.vertices;
+	misses += other.misses;
+}
+
+void MeshOptimizer::Optimize(vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Statistics before = Analyze(indices, vertices.size());
+	meshCount++;
+	importedVertices += vertices.size();
+
+	if (enabled && indices.size() >= 3)
+	{
+		deduplicate(vertices, indices);
+		optimizeCache(indices, vertices.size());
+		optimizeOverdraw(vertices, indices);
+		optimizeFetch(vertices, indices);
+	}
+
+	totalBefore.Add(before);
+	totalAfter.Add(Analyze(indices, vertices.size()));
+	totalMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void MeshOptimizer::OptimizeTriangles(const vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+	if (!enabled || indices.size() < 3)
+		return;
+	optimizeCache(indices, vertices.size());
+	optimizeOverdraw(vertices, indices);
+}
+
+MeshOptimizer::Statistics MeshOptimizer::Analyze(const vector<unsigned int>& indices, size_t vertexCount)
+{
+	Statistics statistics;
+	statistics.triangles = indices.size() / 3;
+	statistics.vertices = vertexCount;
+
+	// a vertex is still in the FIFO when fewer than STATS_CACHE_SIZE misses happened since it went in
+	vector<size_t> insertedAt(vertexCount, 0);
+	size_t time = STATS_CACHE_SIZE + 1;
+	for (unsigned int index : indices)
+	{
+		if (time - insertedAt[index] > (size_t)STATS_CACHE_SIZE)
+		{
+			insertedAt[index] = time++;
+			statistics.misses++;
+		}
+	}
+	return statistics;
+}
+
+void MeshOptimizer::Report(std::ostream& out)
+{
+	out << "Mesh optimizer: " << meshCount << " meshes, " << totalBefore.triangles << " triangles, vertices "
+		<< importedVertices << " -> " << totalAfter.vertices << ", ACMR " << totalBefore.Acmr() << " -> " << totalAfter.Acmr()
+		<< ", ATVR " << totalBefore.Atvr() << " -> " << totalAfter.Atvr() << ", " << totalMilliseconds << " ms"
+		<< (enabled ? "" : " (disabled)") << std::endl;
+}
+
+void MeshOptimizer::deduplicate(vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+	// open addressing on the exact bytes, the first of a group of identical vertices survives
+	size_t tableSize = 1;
+	while (tableSize < vertices.size() * 2)
+		tableSize *= 2;
+	const unsigned int EMPTY = ~0u;
+	vector<unsigned int> table(tableSize, EMPTY);
+	vector<unsigned int> remap(vertices.size());
+	vector<Vertex> unique;
+	unique.reserve(vertices.size());
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		// FNV-1a over the float bit patterns, a word at a time
+		uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+		std::memcpy(words, &vertices[i], sizeof(words));
+		uint32_t hash = 2166136261u;
+		for (uint32_t word : words)
+			hash = (hash ^ word) * 16777619u;
+		hash ^= hash >> 15;
+
+		size_t slot = hash & (tableSize - 1);
+		while (table[slot] != EMPTY && std::memcmp(&unique[table[slot]], &vertices[i], sizeof(Vertex)) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (table[slot] == EMPTY)
+		{
+			table[slot] = (unsigned int)unique.size();
+			unique.push_back(vertices[i]);
+		}
+		remap[i] = table[slot];
+	}
+
+	for (unsigned int& index : indices)
+		index = remap[index];
+	vertices.swap(unique);
+}
+
+float MeshOptimizer::vertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	// both terms only take a few values, they're tabulated once instead of calling pow for every rescore
+	static const unsigned int VALENCE_TABLE_SIZE = 32;
+	static float cacheScores[CACHE_SIZE];
+	static float valenceScores[VALENCE_TABLE_SIZE];
+	static bool tabulated = false;
+	if (!tabulated)
+	{
+		for (int i = 0; i < CACHE_SIZE; i++)
+		{
+			// the last triangle's vertices get a fixed score so the next triangle doesn't just reuse its edge
+			cacheScores[i] = i < 3 ? LAST_TRIANGLE_SCORE : std::pow(1.0f - (float)(i - 3) / (float)(CACHE_SIZE - 3), CACHE_DECAY_POWER);
+		}
+		for (unsigned int i = 1; i < VALENCE_TABLE_SIZE; i++)
+			valenceScores[i] = VALENCE_BOOST_SCALE * std::pow((float)i, -VALENCE_BOOST_POWER);
+		tabulated = true;
+	}
+
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+	if (remainingTriangles < VALENCE_TABLE_SIZE)
+		return score + valenceScores[remainingTriangles];
+	return score + VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+}
+
+void MeshOptimizer::optimizeCache(vector<unsigned int>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+
+	// triangles of every vertex, the first remaining[v] of its range are the ones not emitted yet
+	vector<unsigned int> remaining(vertexCount, 0);
+	for (unsigned int index : indices)
+		remaining[index]++;
+	vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + remaining[v];
+	vector<unsigned int> adjacency(indices.size());
+	vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacency[filled[indices[i]]++] = (unsigned int)(i / 3);
+
+	vector<int> cachePosition(vertexCount, -1);
+	vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = vertexScore(-1, remaining[v]);
+
+	vector<float> triangleScores(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+	vector<bool> emitted(triangleCount, false);
+	vector<unsigned int> result;
+	result.reserve(indices.size());
+	vector<unsigned int> cache, newCache;
+	cache.reserve(CACHE_SIZE + 3);
+	newCache.reserve(CACHE_SIZE + 3);
+
+	int best = -1;
+	size_t cursor = 0;
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		// nothing in the cache has triangles left, continue with the next one of the input
+		if (best < 0)
+		{
+			while (emitted[cursor])
+				cursor++;
+			best = (int)cursor;
+		}
+
+		const unsigned int* triangle = &indices[best * 3];
+		emitted[best] = true;
+		newCache.clear();
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = triangle[k];
+			result.push_back(v);
+
+			unsigned int* first = &adjacency[offsets[v]];
+			unsigned int* last = first + remaining[v];
+			unsigned int* found = std::find(first, last, (unsigned int)best);
+			if (found != last)
+			{
+				std::swap(*found, *(last - 1));
+				remaining[v]--;
+			}
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+				newCache.push_back(v);
+		}
+		for (unsigned int v : cache)
+		{
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				newCache.push_back(v);
+		}
+
+		// rescore everything that was or is in the cache, its triangles move by the same amount
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+			float score = vertexScore(cachePosition[v], remaining[v]);
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+			for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+				triangleScores[adjacency[a]] += delta;
+		}
+		if (newCache.size() > (size_t)CACHE_SIZE)
+			newCache.resize(CACHE_SIZE);
+		cache.swap(newCache);
+
+		best = -1;
+		float bestScore = 0.0f;
+		for (unsigned int v : cache)
+		{
+			for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+			{
+				unsigned int t = adjacency[a];
+				if (best < 0 || triangleScores[t] > bestScore || (triangleScores[t] == bestScore && (int)t < best))
+				{
+					best = (int)t;
+					bestScore = triangleScores[t];
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(const vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+	size_t triangleCount = indices.size() / 3;
+
+	// hard boundaries where the cache order already starts over, every corner of the triangle misses
+	vector<size_t> hardClusters;
+	vector<unsigned char> triangleMisses(triangleCount);
+	vector<size_t> insertedAt(vertices.size(), 0);
+	size_t time = STATS_CACHE_SIZE + 1;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		int misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[t * 3 + k];
+			if (time - insertedAt[v] > (size_t)STATS_CACHE_SIZE)
+			{
+				insertedAt[v] = time++;
+				misses++;
+			}
+		}
+		triangleMisses[t] = (unsigned char)misses;
+		if (t == 0 || misses == 3)
+			hardClusters.push_back(t);
+	}
+	hardClusters.push_back(triangleCount);
+
+	// soft boundaries cut a cluster again once the part before the cut, started with a cold cache,
+	// is within the threshold of the whole cluster
+	vector<size_t> clusters;
+	for (size_t c = 0; c + 1 < hardClusters.size(); c++)
+	{
+		size_t start = hardClusters[c], end = hardClusters[c + 1];
+		size_t hardMisses = 0;
+		for (size_t t = start; t < end; t++)
+			hardMisses += triangleMisses[t];
+		float target = (float)hardMisses / (float)(end - start) * OVERDRAW_THRESHOLD;
+
+		clusters.push_back(start);
+		size_t softStart = start, softMisses = 0;
+		time += STATS_CACHE_SIZE + 1;
+		for (size_t t = start; t < end; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				if (time - insertedAt[v] > (size_t)STATS_CACHE_SIZE)
+				{
+					insertedAt[v] = time++;
+					softMisses++;
+				}
+			}
+			if (t + 1 < end && (float)softMisses / (float)(t + 1 - softStart) <= target)
+			{
+				clusters.push_back(t + 1);
+				softStart = t + 1;
+				softMisses = 0;
+				time += STATS_CACHE_SIZE + 1;
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// area weighted centroid and normal of every cluster and of the mesh
+	size_t clusterCount = clusters.size() - 1;
+	vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+	vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+	vector<float> areas(clusterCount, 0.0f);
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const glm::vec3& a = vertices[indices[t * 3]].Position;
+			const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+			const glm::vec3& p = vertices[indices[t * 3 + 2]].Position;
+			glm::vec3 normal = glm::cross(b - a, p - a);
+			float area = glm::length(normal);
+			centroids[c] += (a + b + p) * (area / 3.0f);
+			normals[c] += normal;
+			areas[c] += area;
+		}
+		meshCentroid += centroids[c];
+		meshArea += areas[c];
+		if (areas[c] > 0.0f)
+			centroids[c] /= areas[c];
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// clusters facing away from the middle tend to cover the rest, they go first
+	vector<float> keys(clusterCount, 0.0f);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float length = glm::length(normals[c]);
+		if (length > 0.0f)
+			keys[c] = glm::dot(centroids[c] - meshCentroid, normals[c] / length);
+	}
+	vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+	vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (size_t c : order)
+		result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	indices.swap(result);
+}
+
+void MeshOptimizer::optimizeFetch(vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+	// vertices in the order the triangles first use them, unused ones are dropped
+	const unsigned int UNUSED = ~0u;
+	vector<unsigned int> remap(vertices.size(), UNUSED);
+	vector<Vertex> ordered;
+	ordered.reserve(vertices.size());
+	for (unsigned int& index : indices)
+	{
+		if (remap[index] == UNUSED)
+		{
+			remap[index] = (unsigned int)ordered.size();
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(ordered);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <ostream>
+#include <vector>
+#include "mesh.hpp"
+
+// Load time reordering of imported meshes, the result only depends on the input so runs stay comparable.
+// Identical vertices are joined, triangles are ordered for the post-transform cache (Forsyth's linear speed
+// optimizer), split into clusters that barely hurt that order and sorted outside in against overdraw (Sander et al.),
+// then the vertices are laid out in the order the triangles first fetch them.
+class MeshOptimizer
+{
+public:
+	// post-transform cache behaviour of an index list, simulated with a FIFO cache of STATS_CACHE_SIZE
+	struct Statistics
+	{
+		size_t triangles = 0;
+		size_t vertices = 0;
+		size_t misses = 0;
+
+		// average cache miss ratio, transformed vertices per triangle (0.5 at best, 3 at worst)
+		float Acmr() const { return triangles == 0 ? 0.0f : (float)misses / (float)triangles; }
+		// average transform to vertex ratio, 1 means every vertex is transformed exactly once
+		float Atvr() const { return vertices == 0 ? 0.0f : (float)misses / (float)vertices; }
+
+		void Add(const Statistics& other);
+	};
+
+	// the whole pipeline, vertices shrinks to the ones the triangles use. Only analyzes when disabled
+	static void Optimize(vector<Vertex>& vertices, vector<unsigned int>& indices);
+	// cache and overdraw order of triangles that share a vertex buffer with others, as LODs do
+	static void OptimizeTriangles(const vector<Vertex>& vertices, vector<unsigned int>& indices);
+	static Statistics Analyze(const vector<unsigned int>& indices, size_t vertexCount);
+
+	static void SetEnabled(bool enabled) { MeshOptimizer::enabled = enabled; }
+	static bool Enabled() { return enabled; }
+	// totals of every mesh passed to Optimize
+	static void Report(std::ostream& out);
+
+private:
+	static const int CACHE_SIZE = 32;
+	static const int STATS_CACHE_SIZE = 16;
+	static const float CACHE_DECAY_POWER;
+	static const float LAST_TRIANGLE_SCORE;
+	static const float VALENCE_BOOST_SCALE;
+	static const float VALENCE_BOOST_POWER;
+	static const float OVERDRAW_THRESHOLD;
+
+	static void deduplicate(vector<Vertex>& vertices, vector<unsigned int>& indices);
+	static void optimizeCache(vector<unsigned int>& indices, size_t vertexCount);
+	static void optimizeOverdraw(const vector<Vertex>& vertices, vector<unsigned int>& indices);
+	static void optimizeFetch(vector<Vertex>& vertices, vector<unsigned int>& indices);
+	static float vertexScore(int cachePosition, unsigned int remainingTriangles);
+
+	static bool enabled;
+	static size_t meshCount;
+	static size_t importedVertices;
+	static Statistics totalBefore;
+	static Statistics totalAfter;
+	static double totalMilliseconds;
+};
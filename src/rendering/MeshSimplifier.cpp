@@ -0,0 +1,280 @@
+#include "MeshSimplifier.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+// border planes stand perpendicular to the surface and keep the outline from shrinking
+const double MeshSimplifier::BORDER_WEIGHT = 10.0;
+// cosine of the largest turn a surviving triangle's normal may take, about 75 degrees
+const float MeshSimplifier::MAX_NORMAL_TURN = 0.25f;
+
+void MeshSimplifier::Quadric::AddPlane(const glm::vec3& normal, float distance, double weight)
+{
+	double a = normal.x, b = normal.y, c = normal.z, d = distance;
+	a00 += weight * a * a; a01 += weight * a * b; a02 += weight * a * c; a03 += weight * a * d;
+	a11 += weight * b * b; a12 += weight * b * c; a13 += weight * b * d;
+	a22 += weight * c * c; a23 += weight * c * d;
+	a33 += weight * d * d;
+	this->weight += weight;
+}
+
+void MeshSimplifier::Quadric::Add(const Quadric& other)
+{
+	a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+	a11 += other.a11; a12 += other.a12; a13 += other.a13;
+	a22 += other.a22; a23 += other.a23;
+	a33 += other.a33;
+	weight += other.weight;
+}
+
+double MeshSimplifier::Quadric::Error(const glm::vec3& point) const
+{
+	double x = point.x, y = point.y, z = point.z;
+	double error = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+		+ a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+		+ a22 * z * z + 2.0 * a23 * z
+		+ a33;
+	return error > 0.0 && weight > 0.0 ? error / weight : 0.0;
+}
+
+static uint64_t edgeKey(unsigned int from, unsigned int to)
+{
+	return ((uint64_t)from << 32) | to;
+}
+
+vector<unsigned int> MeshSimplifier::Simplify(const vector<Vertex>& vertices, const vector<unsigned int>& indices, size_t targetIndexCount, float* error)
+{
+	if (error) { *error = 0.0f; }
+	size_t vertexCount = vertices.size();
+
+	// weld vertices sharing a position, the first one stands in for the group
+	vector<unsigned int> weld(vertexCount);
+	{
+		std::unordered_map<uint64_t, vector<unsigned int>> buckets;
+		for (unsigned int i = 0; i < vertexCount; i++)
+		{
+			const glm::vec3& p = vertices[i].Position;
+			uint32_t bits[3];
+			std::memcpy(bits, &p.x, sizeof(bits));
+			uint64_t hash = ((uint64_t)bits[0] * 73856093u) ^ ((uint64_t)bits[1] * 19349663u) ^ ((uint64_t)bits[2] * 83492791u);
+
+			vector<unsigned int>& bucket = buckets[hash];
+			weld[i] = i;
+			for (unsigned int other : bucket)
+			{
+				if (vertices[other].Position == p) { weld[i] = other; break; }
+			}
+			if (weld[i] == i) { bucket.push_back(i); }
+		}
+	}
+
+	// vertices of every weld group, to pick the best match for a corner that moved
+	vector<unsigned int> groupStart(vertexCount + 1, 0), groupVertices(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; i++) { groupStart[weld[i] + 1]++; }
+	for (size_t i = 0; i < vertexCount; i++) { groupStart[i + 1] += groupStart[i]; }
+	{
+		vector<unsigned int> fill(groupStart.begin(), groupStart.end() - 1);
+		for (unsigned int i = 0; i < vertexCount; i++) { groupVertices[fill[weld[i]]++] = i; }
+	}
+
+	// triangles as welded ids plus the original vertex of every corner
+	vector<unsigned int> triangles, corners;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int a = weld[indices[i]], b = weld[indices[i + 1]], c = weld[indices[i + 2]];
+		if (a == b || b == c || c == a) { continue; }
+		triangles.insert(triangles.end(), { a, b, c });
+		corners.insert(corners.end(), { indices[i], indices[i + 1], indices[i + 2] });
+	}
+
+	// an edge without its opposite is on a border
+	std::unordered_map<uint64_t, int> edges;
+	for (size_t i = 0; i < triangles.size(); i += 3)
+	{
+		for (int e = 0; e < 3; e++) { edges[edgeKey(triangles[i + e], triangles[i + (e + 1) % 3])]++; }
+	}
+
+	vector<Quadric> quadrics(vertexCount);
+	std::memset(quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+	vector<int> borderEdges(vertexCount, 0);
+	for (size_t i = 0; i < triangles.size(); i += 3)
+	{
+		const glm::vec3& p0 = vertices[triangles[i]].Position;
+		const glm::vec3& p1 = vertices[triangles[i + 1]].Position;
+		const glm::vec3& p2 = vertices[triangles[i + 2]].Position;
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float area = glm::length(normal);
+		if (area <= 0.0f) { continue; }
+		normal /= area;
+
+		Quadric face;
+		std::memset(&face, 0, sizeof(face));
+		face.AddPlane(normal, -glm::dot(normal, p0), area);
+		for (int v = 0; v < 3; v++) { quadrics[triangles[i + v]].Add(face); }
+
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int from = triangles[i + e], to = triangles[i + (e + 1) % 3];
+			if (edges.count(edgeKey(to, from))) { continue; }
+
+			glm::vec3 edge = vertices[to].Position - vertices[from].Position;
+			float length = glm::length(edge);
+			if (length <= 0.0f) { continue; }
+
+			glm::vec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+			Quadric border;
+			std::memset(&border, 0, sizeof(border));
+			border.AddPlane(borderNormal, -glm::dot(borderNormal, vertices[from].Position), length * length * BORDER_WEIGHT);
+			quadrics[from].Add(border);
+			quadrics[to].Add(border);
+			borderEdges[from]++;
+			borderEdges[to]++;
+		}
+	}
+
+	vector<unsigned char> kinds(vertexCount, MANIFOLD);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		if (borderEdges[i] == 2) { kinds[i] = BORDER; }
+		else if (borderEdges[i] != 0) { kinds[i] = LOCKED; }
+	}
+
+	double maxCost = 0.0;
+	vector<unsigned int> remap(vertexCount);
+	vector<unsigned int> adjacencyStart(vertexCount + 1), adjacency;
+	vector<unsigned char> touched(vertexCount);
+	vector<Collapse> collapses;
+
+	while (triangles.size() > targetIndexCount)
+	{
+		// triangles around every vertex
+		std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+		for (unsigned int v : triangles) { adjacencyStart[v + 1]++; }
+		for (size_t i = 0; i < vertexCount; i++) { adjacencyStart[i + 1] += adjacencyStart[i]; }
+		adjacency.resize(triangles.size());
+		{
+			vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+			for (size_t i = 0; i < triangles.size(); i++) { adjacency[fill[triangles[i]]++] = (unsigned int)(i / 3); }
+		}
+
+		// cheapest collapse of every vertex, borders may only slide along their own edges
+		collapses.clear();
+		for (size_t i = 0; i < triangles.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int from = triangles[i + e], to = triangles[i + (e + 1) % 3];
+				for (int direction = 0; direction < 2; direction++)
+				{
+					unsigned int u = direction ? to : from, v = direction ? from : to;
+					if (kinds[u] == LOCKED) { continue; }
+					if (kinds[u] == BORDER && (kinds[v] == MANIFOLD || edges.count(edgeKey(v, u)) + edges.count(edgeKey(u, v)) != 1)) { continue; }
+
+					Quadric combined = quadrics[u];
+					combined.Add(quadrics[v]);
+					Collapse collapse = { u, v, combined.Error(vertices[v].Position) };
+					collapses.push_back(collapse);
+				}
+			}
+		}
+		if (collapses.empty()) { break; }
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (size_t i = 0; i < vertexCount; i++) { remap[i] = (unsigned int)i; }
+		std::fill(touched.begin(), touched.end(), 0);
+
+		size_t remaining = triangles.size() / 3;
+		size_t target = targetIndexCount / 3;
+		size_t applied = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (remaining <= target) { break; }
+
+			unsigned int u = collapse.from, v = collapse.to;
+			if (touched[u] || touched[v]) { continue; }
+
+			// moving u onto v must not flip or sharply turn any triangle that survives
+			bool flips = false;
+			size_t removed = 0;
+			const glm::vec3& pu = vertices[u].Position;
+			const glm::vec3& pv = vertices[v].Position;
+			for (unsigned int a = adjacencyStart[u]; a < adjacencyStart[u + 1] && !flips; a++)
+			{
+				const unsigned int* triangle = &triangles[adjacency[a] * 3];
+				if (triangle[0] == v || triangle[1] == v || triangle[2] == v) { removed++; continue; }
+
+				int corner = triangle[0] == u ? 0 : (triangle[1] == u ? 1 : 2);
+				const glm::vec3& pb = vertices[triangle[(corner + 1) % 3]].Position;
+				const glm::vec3& pc = vertices[triangle[(corner + 2) % 3]].Position;
+				glm::vec3 before = glm::cross(pb - pu, pc - pu);
+				glm::vec3 after = glm::cross(pb - pv, pc - pv);
+				flips = glm::dot(before, after) <= MAX_NORMAL_TURN * glm::length(before) * glm::length(after);
+			}
+			if (flips) { continue; }
+
+			// the neighbourhood of u changes shape, nothing touching it collapses again in this pass
+			for (unsigned int a = adjacencyStart[u]; a < adjacencyStart[u + 1]; a++)
+			{
+				const unsigned int* triangle = &triangles[adjacency[a] * 3];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+			}
+
+			remap[u] = v;
+			quadrics[v].Add(quadrics[u]);
+			maxCost = std::max(maxCost, collapse.cost);
+			remaining -= removed;
+			applied++;
+		}
+		if (applied == 0) { break; }
+
+		// rewrite the triangles, a corner that moved takes the closest matching vertex of its new position
+		size_t write = 0;
+		for (size_t i = 0; i < triangles.size(); i += 3)
+		{
+			unsigned int a = remap[triangles[i]], b = remap[triangles[i + 1]], c = remap[triangles[i + 2]];
+			if (a == b || b == c || c == a) { continue; }
+
+			unsigned int welded[3] = { a, b, c };
+			for (int v = 0; v < 3; v++)
+			{
+				unsigned int original = corners[i + v];
+				if (welded[v] != triangles[i + v])
+				{
+					const Vertex& source = vertices[original];
+					float best = -1.0f;
+					for (unsigned int g = groupStart[welded[v]]; g < groupStart[welded[v] + 1]; g++)
+					{
+						const Vertex& candidate = vertices[groupVertices[g]];
+						glm::vec2 uv = candidate.TexCoords - source.TexCoords;
+						glm::vec3 normal = candidate.Normal - source.Normal;
+						float distance = glm::dot(uv, uv) + glm::dot(normal, normal);
+						if (best < 0.0f || distance < best)
+						{
+							best = distance;
+							original = groupVertices[g];
+						}
+					}
+				}
+				triangles[write + v] = welded[v];
+				corners[write + v] = original;
+			}
+			write += 3;
+		}
+		triangles.resize(write);
+		corners.resize(write);
+
+		// edges for the border test of the next pass
+		edges.clear();
+		for (size_t i = 0; i < triangles.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++) { edges[edgeKey(triangles[i + e], triangles[i + (e + 1) % 3])]++; }
+		}
+	}
+
+	if (error) { *error = (float)std::sqrt(maxCost); }
+	return corners;
+}
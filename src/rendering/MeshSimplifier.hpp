@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include "mesh.hpp"
+
+// Quadric error metric simplification (Garland & Heckbert) that only collapses vertices onto existing neighbours,
+// so a simplified index list still refers to the original vertices and can share their vertex buffer.
+// Topology is built on welded positions, models are loaded without joining identical vertices. Open borders only
+// collapse along themselves and their corners stay where they are, which keeps foliage cards and holes in shape.
+// A corner whose vertex collapsed takes the vertex of the target position with the closest normal and uvs.
+class MeshSimplifier
+{
+public:
+	// simplified triangles of indices with at most targetIndexCount indices, or as few as the mesh allows.
+	// error receives the largest collapse error, in model units
+	static vector<unsigned int> Simplify(const vector<Vertex>& vertices, const vector<unsigned int>& indices, size_t targetIndexCount, float* error = nullptr);
+
+private:
+	// symmetric 4x4 error quadric, weighted by area so Error is a mean squared distance
+	struct Quadric
+	{
+		double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+		double weight;
+
+		void AddPlane(const glm::vec3& normal, float distance, double weight);
+		void Add(const Quadric& other);
+		double Error(const glm::vec3& point) const;
+	};
+
+	struct Collapse
+	{
+		unsigned int from, to;
+		double cost;
+	};
+
+	enum VertexKind { MANIFOLD, BORDER, LOCKED };
+
+	static const double BORDER_WEIGHT;
+	static const float MAX_NORMAL_TURN;
+};
@@ -0,0 +1,326 @@
+#include "OcclusionRasterizer.hpp"
+#include "../core/ThreadPool.hpp"
+#include "../core/Profiler.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define OCCLUSION_SSE
+#include <xmmintrin.h>
+#endif
+
+OcclusionRasterizer::OcclusionRasterizer(ThreadPool& pool) : pool(pool), depth(WIDTH * HEIGHT, 1.0f)
+{
+	for (float& tileDepth : tileMaxDepth) { tileDepth = 1.0f; }
+}
+
+int OcclusionRasterizer::AddOccluder(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const glm::mat4& transform)
+{
+	Occluder occluder;
+	occluder.positions = positions;
+	occluder.indices = indices;
+	occluder.transform = transform;
+	occluders.push_back(occluder);
+	return (int)occluders.size() - 1;
+}
+
+void OcclusionRasterizer::ClearOccluders()
+{
+	occluders.clear();
+}
+
+void OcclusionRasterizer::Render(const glm::mat4& newViewProjection)
+{
+	PROFILE_SCOPE("OcclusionRasterizer::Render");
+	viewProjection = newViewProjection;
+
+	// transform every occluder vertex once, in parallel per occluder
+	pool.Run(occluders.size(), [this](size_t index)
+	{
+		Occluder& occluder = occluders[index];
+		glm::mat4 transform = viewProjection * occluder.transform;
+		occluder.clipPositions.resize(occluder.positions.size());
+		for (size_t i = 0; i < occluder.positions.size(); i++)
+		{
+			occluder.clipPositions[i] = transform * glm::vec4(occluder.positions[i], 1.0f);
+		}
+	});
+
+	setupJobs.clear();
+	triangleCount = 0;
+	for (int o = 0; o < (int)occluders.size(); o++)
+	{
+		size_t triangles = occluders[o].indices.size() / 3;
+		triangleCount += triangles;
+		for (size_t first = 0; first < triangles; first += TRIANGLES_PER_JOB)
+		{
+			SetupJob job;
+			job.occluder = o;
+			job.firstTriangle = first;
+			job.triangleCount = std::min((size_t)TRIANGLES_PER_JOB, triangles - first);
+			setupJobs.push_back(job);
+		}
+	}
+
+	if (bins.size() < setupJobs.size()) { bins.resize(setupJobs.size()); }
+	pool.Run(setupJobs.size(), [this](size_t index) { setupTriangles(setupJobs[index], bins[index]); });
+
+	// tiles own disjoint parts of the depth buffer, so they can be rasterized without any locking
+	pool.Run(TILES_X * TILES_Y, [this](size_t tile) { rasterizeTile((int)tile); });
+}
+
+void OcclusionRasterizer::setupTriangles(const SetupJob& job, Bin& bin) const
+{
+	bin.triangles.clear();
+	for (std::vector<unsigned int>& tile : bin.tiles) { tile.clear(); }
+
+	const Occluder& occluder = occluders[job.occluder];
+	for (size_t t = job.firstTriangle; t < job.firstTriangle + job.triangleCount; t++)
+	{
+		glm::vec4 vertices[3];
+		for (int v = 0; v < 3; v++) { vertices[v] = occluder.clipPositions[occluder.indices[t * 3 + v]]; }
+
+		// trivially outside when all three vertices are beyond the same side plane
+		bool outside = false;
+		for (int axis = 0; axis < 2 && !outside; axis++)
+		{
+			outside = (vertices[0][axis] > vertices[0].w && vertices[1][axis] > vertices[1].w && vertices[2][axis] > vertices[2].w) ||
+				(vertices[0][axis] < -vertices[0].w && vertices[1][axis] < -vertices[1].w && vertices[2][axis] < -vertices[2].w);
+		}
+		if (outside) { continue; }
+
+		// clip against the near plane z = -w, a triangle turns into a polygon of at most four vertices
+		glm::vec4 polygon[4];
+		int count = 0;
+		for (int v = 0; v < 3; v++)
+		{
+			const glm::vec4& current = vertices[v];
+			const glm::vec4& next = vertices[(v + 1) % 3];
+			float currentDistance = current.z + current.w;
+			float nextDistance = next.z + next.w;
+
+			if (currentDistance >= 0.0f) { polygon[count++] = current; }
+			if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+			{
+				float t = currentDistance / (currentDistance - nextDistance);
+				polygon[count++] = current + (next - current) * t;
+			}
+		}
+
+		for (int v = 2; v < count; v++)
+		{
+			addTriangle(polygon[0], polygon[v - 1], polygon[v], bin);
+		}
+	}
+}
+
+void OcclusionRasterizer::addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, Bin& bin) const
+{
+	ScreenTriangle triangle;
+	const glm::vec4* vertices[3] = { &a, &b, &c };
+	for (int v = 0; v < 3; v++)
+	{
+		const glm::vec4& clip = *vertices[v];
+		float w = std::max(clip.w, 1e-6f);
+		triangle.x[v] = (clip.x / w * 0.5f + 0.5f) * WIDTH;
+		triangle.y[v] = (clip.y / w * 0.5f + 0.5f) * HEIGHT;
+		triangle.z[v] = std::min(std::max(clip.z / w * 0.5f + 0.5f, 0.0f), 1.0f);
+	}
+
+	float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+	if (area == 0.0f) { return; }
+	if (area < 0.0f)
+	{
+		std::swap(triangle.x[1], triangle.x[2]);
+		std::swap(triangle.y[1], triangle.y[2]);
+		std::swap(triangle.z[1], triangle.z[2]);
+	}
+
+	float minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+	float maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+	float minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+	float maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+	if (maxX < 0.0f || maxY < 0.0f || minX >= WIDTH || minY >= HEIGHT) { return; }
+
+	int firstTileX = std::max(0, (int)minX / TILE_WIDTH), lastTileX = std::min(TILES_X - 1, (int)maxX / TILE_WIDTH);
+	int firstTileY = std::max(0, (int)minY / TILE_HEIGHT), lastTileY = std::min(TILES_Y - 1, (int)maxY / TILE_HEIGHT);
+
+	unsigned int index = (unsigned int)bin.triangles.size();
+	bin.triangles.push_back(triangle);
+	for (int tileY = firstTileY; tileY <= lastTileY; tileY++)
+	{
+		for (int tileX = firstTileX; tileX <= lastTileX; tileX++)
+		{
+			bin.tiles[tileY * TILES_X + tileX].push_back(index);
+		}
+	}
+}
+
+void OcclusionRasterizer::rasterizeTile(int tile)
+{
+	int tileX = tile % TILES_X, tileY = tile / TILES_X;
+	for (int y = tileY * TILE_HEIGHT; y < (tileY + 1) * TILE_HEIGHT; y++)
+	{
+		std::fill(depth.begin() + y * WIDTH + tileX * TILE_WIDTH, depth.begin() + y * WIDTH + (tileX + 1) * TILE_WIDTH, 1.0f);
+	}
+
+	for (size_t job = 0; job < setupJobs.size(); job++)
+	{
+		const Bin& bin = bins[job];
+		for (unsigned int triangle : bin.tiles[tile])
+		{
+			rasterizeTriangle(bin.triangles[triangle], tileX, tileY);
+		}
+	}
+
+	float farthest = 0.0f;
+	for (int y = tileY * TILE_HEIGHT; y < (tileY + 1) * TILE_HEIGHT; y++)
+	{
+		const float* row = &depth[y * WIDTH + tileX * TILE_WIDTH];
+		farthest = std::max(farthest, *std::max_element(row, row + TILE_WIDTH));
+	}
+	tileMaxDepth[tile] = farthest;
+}
+
+void OcclusionRasterizer::rasterizeTriangle(const ScreenTriangle& triangle, int tileX, int tileY)
+{
+	const float* x = triangle.x;
+	const float* y = triangle.y;
+
+	// edge functions are >= 0 inside a counter clockwise triangle
+	float edgeA[3], edgeB[3], edgeC[3];
+	for (int e = 0; e < 3; e++)
+	{
+		int from = e, to = (e + 1) % 3;
+		edgeA[e] = y[from] - y[to];
+		edgeB[e] = x[to] - x[from];
+		edgeC[e] = x[from] * y[to] - x[to] * y[from];
+	}
+
+	// depth is linear in screen space, z = z0 + dzdx * (px - x0) + dzdy * (py - y0)
+	float area = edgeC[0] + edgeC[1] + edgeC[2];
+	float dzdx = ((triangle.z[1] - triangle.z[0]) * (y[2] - y[0]) - (triangle.z[2] - triangle.z[0]) * (y[1] - y[0])) / area;
+	float dzdy = ((triangle.z[2] - triangle.z[0]) * (x[1] - x[0]) - (triangle.z[1] - triangle.z[0]) * (x[2] - x[0])) / area;
+	float z0 = triangle.z[0] - dzdx * x[0] - dzdy * y[0];
+
+	int minX = std::max(tileX * TILE_WIDTH, (int)std::floor(std::min(x[0], std::min(x[1], x[2]))));
+	int maxX = std::min((tileX + 1) * TILE_WIDTH - 1, (int)std::ceil(std::max(x[0], std::max(x[1], x[2]))));
+	int minY = std::max(tileY * TILE_HEIGHT, (int)std::floor(std::min(y[0], std::min(y[1], y[2]))));
+	int maxY = std::min((tileY + 1) * TILE_HEIGHT - 1, (int)std::ceil(std::max(y[0], std::max(y[1], y[2]))));
+	if (minX > maxX || minY > maxY) { return; }
+
+#ifdef OCCLUSION_SSE
+	// four pixels per step, the tiles are a multiple of four wide so the steps never leave the tile
+	minX &= ~3;
+	__m128 laneOffset = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	__m128 a0 = _mm_set1_ps(edgeA[0]), a1 = _mm_set1_ps(edgeA[1]), a2 = _mm_set1_ps(edgeA[2]);
+	__m128 zx = _mm_set1_ps(dzdx);
+	__m128 zero = _mm_setzero_ps();
+
+	for (int py = minY; py <= maxY; py++)
+	{
+		float centerY = py + 0.5f;
+		__m128 rowEdge0 = _mm_set1_ps(edgeB[0] * centerY + edgeC[0]);
+		__m128 rowEdge1 = _mm_set1_ps(edgeB[1] * centerY + edgeC[1]);
+		__m128 rowEdge2 = _mm_set1_ps(edgeB[2] * centerY + edgeC[2]);
+		__m128 rowDepth = _mm_set1_ps(z0 + dzdy * centerY);
+		float* row = &depth[py * WIDTH];
+
+		for (int px = minX; px <= maxX; px += 4)
+		{
+			__m128 centerX = _mm_add_ps(_mm_set1_ps((float)px), laneOffset);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, centerX), rowEdge0), zero),
+				_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, centerX), rowEdge1), zero),
+					_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, centerX), rowEdge2), zero)));
+			if (_mm_movemask_ps(inside) == 0) { continue; }
+
+			__m128 pixelDepth = _mm_add_ps(_mm_mul_ps(zx, centerX), rowDepth);
+			__m128 current = _mm_loadu_ps(row + px);
+			__m128 nearest = _mm_min_ps(current, pixelDepth);
+			_mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+		}
+	}
+#else
+	for (int py = minY; py <= maxY; py++)
+	{
+		float centerY = py + 0.5f;
+		float* row = &depth[py * WIDTH];
+		for (int px = minX; px <= maxX; px++)
+		{
+			float centerX = px + 0.5f;
+			if (edgeA[0] * centerX + edgeB[0] * centerY + edgeC[0] < 0.0f ||
+				edgeA[1] * centerX + edgeB[1] * centerY + edgeC[1] < 0.0f ||
+				edgeA[2] * centerX + edgeB[2] * centerY + edgeC[2] < 0.0f) { continue; }
+
+			row[px] = std::min(row[px], z0 + dzdx * centerX + dzdy * centerY);
+		}
+	}
+#endif
+}
+
+size_t OcclusionRasterizer::Test(const AABB* boxes, size_t count, unsigned char* visible)
+{
+	PROFILE_SCOPE("OcclusionRasterizer::Test");
+
+	size_t hidden = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (visible[i] && occluded(boxes[i])) { visible[i] = 0; hidden++; }
+	}
+	return hidden;
+}
+
+bool OcclusionRasterizer::occluded(const AABB& box) const
+{
+	glm::vec2 rectMin(FLT_MAX), rectMax(-FLT_MAX);
+	float nearest = 1.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+		glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+		// reaching behind the near plane, the box surrounds the camera or is right in front of it
+		if (clip.z < -clip.w) { return false; }
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		rectMin = glm::min(rectMin, glm::vec2(ndc.x, ndc.y));
+		rectMax = glm::max(rectMax, glm::vec2(ndc.x, ndc.y));
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+
+	int minX = std::max(0, (int)std::floor((rectMin.x * 0.5f + 0.5f) * WIDTH));
+	int maxX = std::min(WIDTH - 1, (int)std::floor((rectMax.x * 0.5f + 0.5f) * WIDTH));
+	int minY = std::max(0, (int)std::floor((rectMin.y * 0.5f + 0.5f) * HEIGHT));
+	int maxY = std::min(HEIGHT - 1, (int)std::floor((rectMax.y * 0.5f + 0.5f) * HEIGHT));
+	if (minX > maxX || minY > maxY) { return false; }
+
+	// tiles whose farthest depth is in front of the box settle it without looking at pixels
+	bool tilesInFront = true;
+	for (int tileY = minY / TILE_HEIGHT; tileY <= maxY / TILE_HEIGHT && tilesInFront; tileY++)
+	{
+		for (int tileX = minX / TILE_WIDTH; tileX <= maxX / TILE_WIDTH && tilesInFront; tileX++)
+		{
+			tilesInFront = tileMaxDepth[tileY * TILES_X + tileX] < nearest;
+		}
+	}
+	if (tilesInFront) { return true; }
+
+	// any pixel where the occluders are not in front of the box lets it through
+	for (int y = minY; y <= maxY; y++)
+	{
+		const float* row = &depth[y * WIDTH];
+		int x = minX;
+#ifdef OCCLUSION_SSE
+		__m128 boxDepth = _mm_set1_ps(nearest);
+		for (; x + 3 <= maxX; x += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)) != 0) { return false; }
+		}
+#endif
+		for (; x <= maxX; x++)
+		{
+			if (row[x] >= nearest) { return false; }
+		}
+	}
+	return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "Bounds.hpp"
+#include "IOcclusionTest.hpp"
+
+class ThreadPool;
+
+// Software depth rasterizer for occlusion culling without any GPU round trip. A few designated occluders are
+// rendered into a small depth buffer split into tiles: the occluder vertices are transformed and their triangles
+// clipped against the near plane and binned to tiles in parallel, then every tile rasterizes its triangles on a
+// worker, four pixels at a time with SSE. Test projects world boxes and hides the ones that lie behind the
+// nearest occluder depth of every pixel they cover.
+// Occluders have to be conservative: their surface must never stick out of the geometry they stand in for.
+// Nothing here touches GL.
+class OcclusionRasterizer : public IOcclusionTest
+{
+public:
+	static const int WIDTH = 320;
+	static const int HEIGHT = 180;
+	static const int TILE_WIDTH = 32;
+	static const int TILE_HEIGHT = 30;
+	static const int TILES_X = WIDTH / TILE_WIDTH;
+	static const int TILES_Y = HEIGHT / TILE_HEIGHT;
+	static const int TRIANGLES_PER_JOB = 2048;
+
+	explicit OcclusionRasterizer(ThreadPool& pool);
+
+	// indices are triangles, positions are in the space transform maps to world. Returns the occluder's index
+	int AddOccluder(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const glm::mat4& transform = glm::mat4(1.0f));
+	void ClearOccluders();
+
+	void Render(const glm::mat4& viewProjection);
+	size_t Test(const AABB* boxes, size_t count, unsigned char* visible) override;
+
+	// depth of the last Render, row major from the bottom row up like GL, 1 where nothing was drawn
+	const float* Depth() const { return depth.data(); }
+	size_t TriangleCount() const { return triangleCount; }
+
+private:
+	struct Occluder
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<unsigned int> indices;
+		glm::mat4 transform;
+		std::vector<glm::vec4> clipPositions;
+	};
+
+	// screen space triangle in pixels, counter clockwise, z is window depth
+	struct ScreenTriangle
+	{
+		float x[3], y[3], z[3];
+	};
+
+	// triangles of one setup job and the tiles they touch
+	struct Bin
+	{
+		std::vector<ScreenTriangle> triangles;
+		std::vector<unsigned int> tiles[TILES_X * TILES_Y];
+	};
+
+	struct SetupJob
+	{
+		int occluder;
+		size_t firstTriangle, triangleCount;
+	};
+
+	ThreadPool& pool;
+	std::vector<Occluder> occluders;
+	std::vector<SetupJob> setupJobs;
+	std::vector<Bin> bins;
+	std::vector<float> depth;
+	float tileMaxDepth[TILES_X * TILES_Y];
+	glm::mat4 viewProjection;
+	size_t triangleCount = 0;
+
+	void setupTriangles(const SetupJob& job, Bin& bin) const;
+	void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, Bin& bin) const;
+	void rasterizeTile(int tile);
+	void rasterizeTriangle(const ScreenTriangle& triangle, int tileX, int tileY);
+	bool occluded(const AABB& box) const;
+};
@@ -0,0 +1,451 @@
+#include "RenderGraph.hpp"
+#include "GLState.hpp"
+#include "../core/Profiler.hpp"
+#include <algorithm>
+#include <iostream>
+
+RenderGraph::~RenderGraph()
+{
+	release();
+}
+
+void RenderGraph::Builder::Read(Resource resource)
+{
+	if (resource < 0 || resource >= (Resource)graph.versions.size())
+	{
+		std::cout << "ERROR RenderGraph pass " << graph.passes[pass].name << " reads an unknown resource" << std::endl;
+		return;
+	}
+
+	graph.versions[resource].readers.push_back(pass);
+	graph.passes[pass].reads.push_back(resource);
+}
+
+RenderGraph::Resource RenderGraph::Builder::Write(Resource resource)
+{
+	if (resource < 0 || resource >= (Resource)graph.versions.size())
+	{
+		std::cout << "ERROR RenderGraph pass " << graph.passes[pass].name << " writes an unknown resource" << std::endl;
+		return resource;
+	}
+
+	// writing an old version would fork the resource, the write goes on top of the newest one instead
+	ResourceInfo& info = graph.resources[graph.versions[resource].resource];
+	if (info.latestVersion != resource)
+	{
+		std::cout << "ERROR RenderGraph pass " << graph.passes[pass].name << " writes an outdated version of " << info.name << std::endl;
+	}
+
+	Version version;
+	version.resource = graph.versions[resource].resource;
+	version.producer = pass;
+	version.previous = info.latestVersion;
+	graph.versions.push_back(version);
+
+	info.latestVersion = (int)graph.versions.size() - 1;
+	graph.passes[pass].writes.push_back(info.latestVersion);
+	return info.latestVersion;
+}
+
+RenderGraph::Resource RenderGraph::addResource(const char* name, ResourceKind kind, const TextureDesc& desc, GLuint framebuffer)
+{
+	ResourceInfo info;
+	info.name = name;
+	info.kind = kind;
+	info.desc = desc;
+	info.framebuffer = framebuffer;
+	info.texture = -1;
+
+	Version version;
+	version.resource = (int)resources.size();
+	version.producer = -1;
+	version.previous = -1;
+	versions.push_back(version);
+
+	info.latestVersion = (int)versions.size() - 1;
+	resources.push_back(info);
+	return info.latestVersion;
+}
+
+RenderGraph::Resource RenderGraph::CreateTexture(const char* name, const TextureDesc& desc)
+{
+	return addResource(name, TRANSIENT, desc, 0);
+}
+
+RenderGraph::Resource RenderGraph::ImportTarget(const char* name, GLuint framebuffer, int width, int height)
+{
+	TextureDesc desc = { width, height, GL_NONE };
+	return addResource(name, IMPORTED, desc, framebuffer);
+}
+
+RenderGraph::Resource RenderGraph::CreateData(const char* name)
+{
+	TextureDesc desc = { 0, 0, GL_NONE };
+	return addResource(name, DATA, desc, 0);
+}
+
+void RenderGraph::AddPass(const char* name, const SetupFunction& setup, const ExecuteFunction& execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.alive = false;
+	pass.phase = Profiler::RegisterPhase((std::string("pass:") + name).c_str());
+	pass.framebuffer = -1;
+	pass.width = pass.height = 0;
+	passes.push_back(pass);
+
+	Builder builder(*this, (int)passes.size() - 1);
+	setup(builder);
+}
+
+bool RenderGraph::Compile()
+{
+	release();
+
+	cullPasses();
+	if (!sortPasses())
+	{
+		std::cout << "ERROR RenderGraph passes depend on each other in a cycle" << std::endl;
+		return false;
+	}
+	assignTextures();
+	createFramebuffers();
+	return true;
+}
+
+void RenderGraph::cullPasses()
+{
+	// the passes writing an imported target are the frame's output, everything they need survives with them
+	std::vector<int> pending;
+	for (size_t p = 0; p < passes.size(); p++)
+	{
+		passes[p].alive = false;
+		for (int write : passes[p].writes)
+		{
+			if (resources[versions[write].resource].kind == IMPORTED)
+			{
+				passes[p].alive = true;
+			}
+		}
+		if (passes[p].alive) { pending.push_back((int)p); }
+	}
+
+	while (!pending.empty())
+	{
+		const Pass& pass = passes[pending.back()];
+		pending.pop_back();
+
+		std::vector<int> needed;
+		for (int read : pass.reads) { needed.push_back(versions[read].producer); }
+		for (int write : pass.writes) { needed.push_back(versions[versions[write].previous].producer); }
+
+		for (int producer : needed)
+		{
+			if (producer >= 0 && !passes[producer].alive)
+			{
+				passes[producer].alive = true;
+				pending.push_back(producer);
+			}
+		}
+	}
+}
+
+bool RenderGraph::sortPasses()
+{
+	// a pass waits for the producers of what it reads or draws on, and for the readers of what it overwrites
+	size_t count = passes.size();
+	std::vector<std::vector<int>> dependents(count);
+	std::vector<int> waitingOn(count, 0);
+	size_t aliveCount = 0;
+
+	for (size_t p = 0; p < count; p++)
+	{
+		if (!passes[p].alive) { continue; }
+		aliveCount++;
+
+		std::vector<int> dependencies;
+		for (int read : passes[p].reads) { dependencies.push_back(versions[read].producer); }
+		for (int write : passes[p].writes)
+		{
+			const Version& previous = versions[versions[write].previous];
+			dependencies.push_back(previous.producer);
+			dependencies.insert(dependencies.end(), previous.readers.begin(), previous.readers.end());
+		}
+
+		std::sort(dependencies.begin(), dependencies.end());
+		dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+		for (int dependency : dependencies)
+		{
+			if (dependency < 0 || dependency == (int)p || !passes[dependency].alive) { continue; }
+			dependents[dependency].push_back((int)p);
+			waitingOn[p]++;
+		}
+	}
+
+	// Kahn's algorithm, ties go to the pass that was added first so the order only changes where it has to
+	order.clear();
+	std::vector<bool> scheduled(count, false);
+	while (order.size() < aliveCount)
+	{
+		int next = -1;
+		for (size_t p = 0; p < count; p++)
+		{
+			if (passes[p].alive && !scheduled[p] && waitingOn[p] == 0)
+			{
+				next = (int)p;
+				break;
+			}
+		}
+		if (next < 0) { return false; }
+
+		scheduled[next] = true;
+		order.push_back(next);
+		for (int dependent : dependents[next]) { waitingOn[dependent]--; }
+	}
+	return true;
+}
+
+void RenderGraph::assignTextures()
+{
+	// first and last position in the order each transient texture is touched
+	std::vector<int> firstUse(resources.size(), -1), lastUse(resources.size(), -1);
+	for (size_t position = 0; position < order.size(); position++)
+	{
+		const Pass& pass = passes[order[position]];
+		std::vector<int> used(pass.reads);
+		used.insert(used.end(), pass.writes.begin(), pass.writes.end());
+
+		for (int version : used)
+		{
+			int resource = versions[version].resource;
+			if (resources[resource].kind != TRANSIENT) { continue; }
+			if (firstUse[resource] < 0) { firstUse[resource] = (int)position; }
+			lastUse[resource] = (int)position;
+		}
+	}
+
+	std::vector<int> transients;
+	for (size_t r = 0; r < resources.size(); r++)
+	{
+		resources[r].texture = -1;
+		if (firstUse[r] >= 0) { transients.push_back((int)r); }
+	}
+	std::stable_sort(transients.begin(), transients.end(), [&firstUse](int a, int b) { return firstUse[a] < firstUse[b]; });
+
+	// a texture whose last user already ran is handed to the next resource of the same size and format
+	for (int r : transients)
+	{
+		const TextureDesc& desc = resources[r].desc;
+		size_t bytes = (size_t)desc.width * desc.height * bytesPerPixel(desc.internalFormat);
+		requestedBytes += bytes;
+
+		int texture = -1;
+		for (size_t t = 0; t < textures.size(); t++)
+		{
+			const TextureDesc& other = textures[t].desc;
+			if (textures[t].lastUse < firstUse[r] && other.width == desc.width && other.height == desc.height
+				&& other.internalFormat == desc.internalFormat)
+			{
+				texture = (int)t;
+				break;
+			}
+		}
+
+		if (texture < 0)
+		{
+			PhysicalTexture physical;
+			physical.desc = desc;
+			glGenTextures(1, &physical.id);
+			GLState::BindTexture(GL_TEXTURE_2D, physical.id);
+
+			// the pixel format only has to be valid for the internal format, there is no data to upload
+			GLenum format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+			if (desc.internalFormat == GL_DEPTH24_STENCIL8) { format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; }
+			else if (desc.internalFormat == GL_DEPTH32F_STENCIL8) { format = GL_DEPTH_STENCIL; type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; }
+			else if (isDepthFormat(desc.internalFormat)) { format = GL_DEPTH_COMPONENT; type = GL_FLOAT; }
+			glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, format, type, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			textures.push_back(physical);
+			allocatedBytes += bytes;
+			texture = (int)textures.size() - 1;
+		}
+
+		textures[texture].lastUse = lastUse[r];
+		resources[r].texture = texture;
+	}
+}
+
+void RenderGraph::createFramebuffers()
+{
+	for (int p : order)
+	{
+		Pass& pass = passes[p];
+		pass.framebuffer = -1;
+
+		std::vector<int> attachments;
+		for (int write : pass.writes)
+		{
+			const ResourceInfo& info = resources[versions[write].resource];
+			if (info.kind == IMPORTED)
+			{
+				if (pass.framebuffer >= 0 && pass.framebuffer != (GLint)info.framebuffer)
+				{
+					std::cout << "ERROR RenderGraph pass " << pass.name << " writes targets of different framebuffers" << std::endl;
+				}
+				pass.framebuffer = (GLint)info.framebuffer;
+				pass.width = info.desc.width;
+				pass.height = info.desc.height;
+			}
+			else if (info.kind == TRANSIENT)
+			{
+				attachments.push_back(versions[write].resource);
+			}
+		}
+
+		if (attachments.empty()) { continue; }
+		if (pass.framebuffer >= 0)
+		{
+			std::cout << "ERROR RenderGraph pass " << pass.name << " writes an imported target and transient textures" << std::endl;
+			continue;
+		}
+
+		GLuint framebuffer;
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+		std::vector<GLenum> drawBuffers;
+		for (int resource : attachments)
+		{
+			const ResourceInfo& info = resources[resource];
+			GLuint texture = textures[info.texture].id;
+			GLenum attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+			if (info.desc.internalFormat == GL_DEPTH24_STENCIL8 || info.desc.internalFormat == GL_DEPTH32F_STENCIL8)
+			{
+				attachment = GL_DEPTH_STENCIL_ATTACHMENT;
+			}
+			else if (isDepthFormat(info.desc.internalFormat))
+			{
+				attachment = GL_DEPTH_ATTACHMENT;
+			}
+			else
+			{
+				drawBuffers.push_back(attachment);
+			}
+
+			glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+			pass.width = info.desc.width;
+			pass.height = info.desc.height;
+		}
+
+		if (drawBuffers.empty()) { glDrawBuffer(GL_NONE); }
+		else { glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data()); }
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR RenderGraph framebuffer of pass " << pass.name << " is not complete" << std::endl;
+		}
+
+		framebuffers.push_back(framebuffer);
+		pass.framebuffer = (GLint)framebuffer;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RenderGraph::Execute()
+{
+	for (int p : order)
+	{
+		const Pass& pass = passes[p];
+		if (pass.framebuffer >= 0)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)pass.framebuffer);
+			glViewport(0, 0, pass.width, pass.height);
+		}
+
+		ProfileScope scope(pass.phase);
+		pass.execute();
+	}
+}
+
+GLuint RenderGraph::Texture(Resource resource) const
+{
+	if (resource < 0 || resource >= (Resource)versions.size()) { return 0; }
+
+	const ResourceInfo& info = resources[versions[resource].resource];
+	return info.texture >= 0 ? textures[info.texture].id : 0;
+}
+
+void RenderGraph::Report(std::ostream& out) const
+{
+	out << "Render graph:";
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		out << (i == 0 ? " " : " -> ") << passes[order[i]].name;
+	}
+
+	bool anyCulled = false;
+	for (const Pass& pass : passes)
+	{
+		if (pass.alive) { continue; }
+		out << (anyCulled ? ", " : ", culled: ") << pass.name;
+		anyCulled = true;
+	}
+	out << std::endl;
+
+	out << "Render graph transient textures: " << requestedBytes / 1024 << " KiB requested, "
+		<< allocatedBytes / 1024 << " KiB allocated in " << textures.size() << " textures" << std::endl;
+}
+
+void RenderGraph::release()
+{
+	for (const PhysicalTexture& texture : textures)
+	{
+		glDeleteTextures(1, &texture.id);
+	}
+	if (!framebuffers.empty())
+	{
+		glDeleteFramebuffers((GLsizei)framebuffers.size(), framebuffers.data());
+	}
+	// the state cache may still think a deleted texture is bound
+	if (!textures.empty()) { GLState::Invalidate(); }
+
+	textures.clear();
+	framebuffers.clear();
+	requestedBytes = 0;
+	allocatedBytes = 0;
+}
+
+bool RenderGraph::isDepthFormat(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_DEPTH_COMPONENT:
+	case GL_DEPTH_COMPONENT16:
+	case GL_DEPTH_COMPONENT24:
+	case GL_DEPTH_COMPONENT32:
+	case GL_DEPTH_COMPONENT32F:
+	case GL_DEPTH24_STENCIL8:
+	case GL_DEPTH32F_STENCIL8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+size_t RenderGraph::bytesPerPixel(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_R8: return 1;
+	case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+	case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+	case GL_RGBA32F: return 16;
+	default: return 4;
+	}
+}
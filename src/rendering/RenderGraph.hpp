@@ -0,0 +1,134 @@
+#pragma once
+#include <glad/glad.h>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Declarative description of a frame. Passes are added once at setup together with the resources they read and
+// write; Compile orders them by those dependencies, drops passes whose results nothing uses and gives the transient
+// textures GL textures, letting textures whose lifetimes don't overlap share one. Execute runs the remaining passes,
+// binding a framebuffer with the attachments each pass writes and timing every pass as a "pass:<name>" phase.
+// Resources are versioned: writing one returns a new handle, passes reading the old handle run before the write.
+class RenderGraph
+{
+public:
+	typedef int Resource;
+
+	struct TextureDesc
+	{
+		int width;
+		int height;
+		GLenum internalFormat;
+	};
+
+	// what a pass's setup function declares its reads and writes with
+	class Builder
+	{
+	public:
+		void Read(Resource resource);
+		// the pass draws on top of the current contents unless it clears them itself
+		Resource Write(Resource resource);
+
+	private:
+		Builder(RenderGraph& graph, int pass) : graph(graph), pass(pass) {}
+
+		RenderGraph& graph;
+		int pass;
+
+		friend class RenderGraph;
+	};
+
+	typedef std::function<void(Builder&)> SetupFunction;
+	typedef std::function<void()> ExecuteFunction;
+
+	RenderGraph() {}
+	~RenderGraph();
+
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	// contents are undefined until a pass writes them, textures are shared so the first writer has to clear
+	Resource CreateTexture(const char* name, const TextureDesc& desc);
+	// render target owned by someone else, the passes writing it are the output of the frame and always run
+	Resource ImportTarget(const char* name, GLuint framebuffer, int width, int height);
+	// result without storage that only orders passes, like the visible set culling hands to the models pass
+	Resource CreateData(const char* name);
+
+	// setup runs right away, execute every frame the pass survives culling
+	void AddPass(const char* name, const SetupFunction& setup, const ExecuteFunction& execute);
+
+	// needs a current context, returns false when the passes depend on each other in a cycle
+	bool Compile();
+	void Execute();
+
+	// texture behind a transient resource, 0 before Compile or when no surviving pass uses it
+	GLuint Texture(Resource resource) const;
+
+	// order of the passes, the culled ones and the transient memory with and without aliasing
+	void Report(std::ostream& out) const;
+
+private:
+	enum ResourceKind { TRANSIENT, IMPORTED, DATA };
+
+	struct ResourceInfo
+	{
+		std::string name;
+		ResourceKind kind;
+		TextureDesc desc;
+		GLuint framebuffer;
+		int latestVersion;
+		// index into textures, -1 while unallocated
+		int texture;
+	};
+
+	// every write makes a new version, the producer is -1 for the contents a resource starts the frame with
+	struct Version
+	{
+		int resource;
+		int producer;
+		// version this one was written on top of, -1 for the first
+		int previous;
+		std::vector<int> readers;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		ExecuteFunction execute;
+		std::vector<int> reads;
+		// versions this pass produced, their previous version is the one it draws on top of
+		std::vector<int> writes;
+		bool alive;
+		int phase;
+		// framebuffer to bind before executing, -1 when the pass only writes data
+		GLint framebuffer;
+		int width, height;
+	};
+
+	struct PhysicalTexture
+	{
+		GLuint id;
+		TextureDesc desc;
+		// position in the execution order after which another resource may take it over
+		int lastUse;
+	};
+
+	std::vector<ResourceInfo> resources;
+	std::vector<Version> versions;
+	std::vector<Pass> passes;
+	std::vector<int> order;
+	std::vector<PhysicalTexture> textures;
+	std::vector<GLuint> framebuffers;
+	size_t requestedBytes = 0;
+	size_t allocatedBytes = 0;
+
+	Resource addResource(const char* name, ResourceKind kind, const TextureDesc& desc, GLuint framebuffer);
+	void cullPasses();
+	bool sortPasses();
+	void assignTextures();
+	void createFramebuffers();
+	void release();
+	static bool isDepthFormat(GLenum internalFormat);
+	static size_t bytesPerPixel(GLenum internalFormat);
+};
@@ -0,0 +1,373 @@
+#include "RenderQueue.hpp"
+#include "Material.hpp"
+#include "mesh.hpp"
+#include "GLState.hpp"
+#include "GLExtensions.hpp"
+#include "GpuProfiler.hpp"
+#include "../core/Profiler.hpp"
+#include <GLFW/glfw3.h>
+#include <cstring>
+#include <iostream>
+
+// GL 4.3 / GL_ARB_multi_draw_indirect, not part of the generated loader
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+typedef void (APIENTRYP MultiDrawElementsIndirectFunction)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+static MultiDrawElementsIndirectFunction glMultiDrawElementsIndirectPointer = nullptr;
+
+static const int PASS_SHIFT = 62;
+static const int PROGRAM_SHIFT = 52;
+static const int TEXTURE_SET_SHIFT = 40;
+static const int MESH_SHIFT = 30;
+static const int LOD_SHIFT = 28;
+
+static const uint64_t PROGRAM_MASK = (1ull << 10) - 1;
+static const uint64_t TEXTURE_SET_MASK = (1ull << 12) - 1;
+static const uint64_t MESH_MASK = (1ull << 10) - 1;
+static const uint64_t LOD_MASK = (1ull << 2) - 1;
+static const uint64_t DEPTH_MASK = (1ull << 28) - 1;
+
+void RenderQueue::Init()
+{
+	// drawBatch offsets the instance attributes with baseInstance, which is reserved without GL 4.2 / ARB_base_instance
+	bool supported = GLExtensions::VersionAtLeast(4, 3)
+		|| (GLExtensions::Supported("GL_ARB_multi_draw_indirect") && GLExtensions::Supported("GL_ARB_draw_indirect")
+			&& (GLExtensions::VersionAtLeast(4, 2) || GLExtensions::Supported("GL_ARB_base_instance")));
+	if (supported)
+	{
+		glMultiDrawElementsIndirectPointer = (MultiDrawElementsIndirectFunction)glfwGetProcAddress("glMultiDrawElementsIndirect");
+	}
+
+	multiDrawIndirect = glMultiDrawElementsIndirectPointer != nullptr;
+	if (!multiDrawIndirect)
+	{
+		std::cout << "Multi-draw indirect is not supported, merging draws with glMultiDrawElementsBaseVertex" << std::endl;
+	}
+
+	Material::createProgram(depthProgram, "assets/shaders/modelDepthVertex.glsl", "assets/shaders/modelDepthFragment.glsl");
+	GLState::UseProgram(depthProgram);
+	Material::GetUniform<int>(depthProgram, "texture_diffuse1").Set(SLOT_DIFFUSE);
+}
+
+void RenderQueue::Begin(const glm::vec3& viewPosition)
+{
+	this->viewPosition = viewPosition;
+	packets.clear();
+	entries.clear();
+}
+
+void RenderQueue::Submit(Pass pass, const DrawPacket& packet)
+{
+	glm::vec3 offset = glm::vec3(packet.transform[3]) - viewPosition;
+	uint64_t depth = depthBits(glm::dot(offset, offset));
+	if (pass == TRANSPARENT_PASS) { depth = DEPTH_MASK - depth; }
+
+	SortEntry entry;
+	entry.key = ((uint64_t)pass << PASS_SHIFT)
+		| ((compactID(programIDs, packet.material->shaderProgram) & PROGRAM_MASK) << PROGRAM_SHIFT)
+		| (((uint64_t)packet.mesh->textureSet & TEXTURE_SET_MASK) << TEXTURE_SET_SHIFT)
+		| ((compactID(meshIDs, (const Mesh*)packet.mesh) & MESH_MASK) << MESH_SHIFT)
+		| (((uint64_t)packet.lod & LOD_MASK) << LOD_SHIFT)
+		| depth;
+	entry.packet = (uint32_t)packets.size();
+
+	packets.push_back(packet);
+	entries.push_back(entry);
+}
+
+void RenderQueue::Execute()
+{
+	static const int packetPhase = Profiler::RegisterPhase("queue packets", Profiler::Unit::Count);
+	static const int drawPhase = Profiler::RegisterPhase("queue draw calls", Profiler::Unit::Count);
+	static const int programPhase = Profiler::RegisterPhase("queue program switches", Profiler::Unit::Count);
+	static const int texturePhase = Profiler::RegisterPhase("queue texture set switches", Profiler::Unit::Count);
+	static const int vaoPhase = Profiler::RegisterPhase("queue vao switches", Profiler::Unit::Count);
+	static const int trianglePhase = Profiler::RegisterPhase("queue triangles", Profiler::Unit::Count);
+
+	{
+		PROFILE_SCOPE("RenderQueue::Sort");
+		radixSort();
+	}
+	uploadInstances();
+	buildBatches();
+	if (multiDrawIndirect)
+	{
+		uploadCommands();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+	}
+
+	if (depthPrepass)
+	{
+		drawDepth();
+	}
+
+	GPU_PASS_SCOPE("models");
+
+	unsigned int programSwitches = 0, textureSwitches = 0, vaoSwitches = 0;
+	uint64_t previous = ~0ull;
+	GLuint previousVAO = 0;
+
+	for (const Batch& batch : batches)
+	{
+		const SortEntry& entry = entries[batch.firstEntry];
+		uint64_t changed = entry.key ^ previous;
+
+		if (changed >> PASS_SHIFT) { applyPassState((Pass)(entry.key >> PASS_SHIFT)); }
+		if ((changed >> PROGRAM_SHIFT) != 0)
+		{
+			packets[entry.packet].material->Use();
+			programSwitches++;
+		}
+		if ((changed >> TEXTURE_SET_SHIFT) != 0) { textureSwitches++; }
+		if (packets[entry.packet].mesh->VAO != previousVAO) { vaoSwitches++; }
+
+		drawBatch(batch);
+		previous = entry.key;
+		previousVAO = packets[entry.packet].mesh->VAO;
+	}
+
+	if (multiDrawIndirect) { glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0); }
+
+	// the next frame's depth clear is masked by the depth write mask
+	GLState::DepthFunc(GL_LESS);
+	GLState::DepthMask(GL_TRUE);
+
+	Profiler::AddCount(packetPhase, (double)entries.size());
+	Profiler::AddCount(drawPhase, (double)batches.size());
+	Profiler::AddCount(programPhase, programSwitches);
+	Profiler::AddCount(texturePhase, textureSwitches);
+	Profiler::AddCount(vaoPhase, vaoSwitches);
+
+	double triangles = 0.0;
+	for (const DrawCommand& command : commands) { triangles += (double)(command.count / 3) * command.instanceCount; }
+	Profiler::AddCount(trianglePhase, triangles);
+}
+
+void RenderQueue::buildBatches()
+{
+	commands.clear();
+	batches.clear();
+
+	size_t batchEntry = 0;
+	for (size_t first = 0; first < entries.size();)
+	{
+		const SortEntry& entry = entries[first];
+		const DrawPacket& packet = packets[entry.packet];
+
+		// the run of packets drawing the same mesh level with the same material becomes one instanced draw
+		size_t last = first + 1;
+		while (last < entries.size()
+			&& (entries[last].key >> LOD_SHIFT) == (entry.key >> LOD_SHIFT)
+			&& packets[entries[last].packet].mesh == packet.mesh
+			&& packets[entries[last].packet].lod == packet.lod
+			&& packets[entries[last].packet].material == packet.material)
+		{
+			last++;
+		}
+
+		const MeshLod& lod = packet.mesh->lods[packet.lod];
+		DrawCommand command;
+		command.count = (GLuint)lod.indexCount;
+		command.instanceCount = (GLuint)(last - first);
+		command.firstIndex = lod.firstIndex;
+		command.baseVertex = packet.mesh->geometry.baseVertex;
+		command.baseInstance = (GLuint)first;
+
+		// same pass, program, textures and arena as the open batch: only the geometry range differs
+		bool merge = false;
+		if (!batches.empty()
+			&& (entries[batchEntry].key >> TEXTURE_SET_SHIFT) == (entry.key >> TEXTURE_SET_SHIFT)
+			&& packets[entries[batchEntry].packet].material == packet.material
+			&& packets[entries[batchEntry].packet].mesh->arena == packet.mesh->arena)
+		{
+			const DrawCommand& previous = commands.back();
+			merge = multiDrawIndirect
+				|| (previous.instanceCount == 1 && command.instanceCount == 1
+					&& std::memcmp(&instanceData[previous.baseInstance], &instanceData[first], sizeof(glm::mat4)) == 0);
+		}
+
+		if (merge)
+		{
+			batches.back().commandCount++;
+		}
+		else
+		{
+			Batch batch;
+			batch.firstEntry = first;
+			batch.firstCommand = commands.size();
+			batch.commandCount = 1;
+			batches.push_back(batch);
+			batchEntry = first;
+		}
+		commands.push_back(command);
+
+		first = last;
+	}
+}
+
+void RenderQueue::drawBatch(const Batch& batch)
+{
+	const DrawPacket& packet = packets[entries[batch.firstEntry].packet];
+	GeometryArena* arena = packet.mesh->arena;
+	const DrawCommand* command = &commands[batch.firstCommand];
+
+	packet.mesh->BindTextures();
+	GLState::BindVertexArray(arena->VAO());
+
+	if (multiDrawIndirect)
+	{
+		// the base instance of every command offsets the instance attributes
+		arena->BindInstances(instanceBuffer, INSTANCE_ATTRIBUTE, 0);
+		glMultiDrawElementsIndirectPointer(GL_TRIANGLES, arena->IndexType(), (void*)(batch.firstCommand * sizeof(DrawCommand)), batch.commandCount, 0);
+		return;
+	}
+
+	arena->BindInstances(instanceBuffer, INSTANCE_ATTRIBUTE, command->baseInstance);
+	if (batch.commandCount == 1)
+	{
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command->count, arena->IndexType(),
+			arena->IndexOffset(command->firstIndex), command->instanceCount, command->baseVertex);
+		return;
+	}
+
+	// merged commands all draw one instance of the same transform
+	multiCounts.clear();
+	multiOffsets.clear();
+	multiBaseVertices.clear();
+	for (GLsizei i = 0; i < batch.commandCount; i++)
+	{
+		multiCounts.push_back(command[i].count);
+		multiOffsets.push_back(arena->IndexOffset(command[i].firstIndex));
+		multiBaseVertices.push_back(command[i].baseVertex);
+	}
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, multiCounts.data(), arena->IndexType(), multiOffsets.data(), batch.commandCount, multiBaseVertices.data());
+}
+
+void RenderQueue::drawDepth()
+{
+	GPU_PASS_SCOPE("models depth");
+
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::Enable(GL_CULL_FACE);
+	GLState::CullFace(GL_BACK);
+	GLState::Disable(GL_BLEND);
+	GLState::DepthFunc(GL_LESS);
+	GLState::DepthMask(GL_TRUE);
+	GLState::ColorMask(GL_FALSE);
+	GLState::UseProgram(depthProgram);
+
+	// the batches keep their textures, the alpha test needs the diffuse map. Transparent batches sort last
+	for (const Batch& batch : batches)
+	{
+		if ((entries[batch.firstEntry].key >> PASS_SHIFT) != OPAQUE_PASS) { break; }
+		drawBatch(batch);
+	}
+
+	GLState::ColorMask(GL_TRUE);
+}
+
+void RenderQueue::uploadCommands()
+{
+	if (indirectBuffer == 0) { glGenBuffers(1, &indirectBuffer); }
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+
+	while (indirectCapacity < commands.size()) { indirectCapacity = indirectCapacity == 0 ? 64 : indirectCapacity * 2; }
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCapacity * sizeof(DrawCommand), nullptr, GL_STREAM_DRAW);
+	if (!commands.empty())
+	{
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawCommand), commands.data());
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void RenderQueue::applyPassState(Pass pass)
+{
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::Enable(GL_CULL_FACE);
+	GLState::CullFace(GL_BACK);
+
+	if (pass == TRANSPARENT_PASS)
+	{
+		GLState::Enable(GL_BLEND);
+		GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GLState::DepthFunc(GL_LESS);
+		GLState::DepthMask(GL_FALSE);
+	}
+	else
+	{
+		// after the pre-pass only the surface it kept passes, its depth is already in the buffer
+		GLState::Disable(GL_BLEND);
+		GLState::DepthFunc(depthPrepass ? GL_EQUAL : GL_LESS);
+		GLState::DepthMask(depthPrepass ? GL_FALSE : GL_TRUE);
+	}
+}
+
+void RenderQueue::uploadInstances()
+{
+	instanceData.resize(entries.size());
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		instanceData[i] = packets[entries[i].packet].transform;
+	}
+
+	if (instanceBuffer == 0) { glGenBuffers(1, &instanceBuffer); }
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+	// grow to the next power of two so the buffer is only reallocated a few times, otherwise orphan and refill
+	while (instanceCapacity < instanceData.size()) { instanceCapacity = instanceCapacity == 0 ? 64 : instanceCapacity * 2; }
+	glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+	if (!instanceData.empty())
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, 0, instanceData.size() * sizeof(glm::mat4), instanceData.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+template <typename Name>
+uint64_t RenderQueue::compactID(std::unordered_map<Name, uint64_t>& ids, Name name)
+{
+	auto found = ids.find(name);
+	if (found != ids.end()) { return found->second; }
+
+	uint64_t id = ids.size();
+	ids[name] = id;
+	return id;
+}
+
+uint64_t RenderQueue::depthBits(float distanceSquared)
+{
+	// positive floats sort like their bit patterns, dropping the sign bit and 3 mantissa bits leaves 28 bits
+	uint32_t bits;
+	std::memcpy(&bits, &distanceSquared, sizeof(bits));
+	return (bits >> 3) & DEPTH_MASK;
+}
+
+void RenderQueue::radixSort()
+{
+	// LSD radix sort on 8-bit digits, digits every key agrees on (usually pass and program) are skipped
+	size_t count = entries.size();
+	scratch.resize(count);
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t histogram[256] = { 0 };
+		for (const SortEntry& entry : entries)
+		{
+			histogram[(entry.key >> shift) & 0xFF]++;
+		}
+		if (count == 0 || histogram[(entries[0].key >> shift) & 0xFF] == count) { continue; }
+
+		size_t offset = 0;
+		for (size_t& bucket : histogram)
+		{
+			size_t size = bucket;
+			bucket = offset;
+			offset += size;
+		}
+
+		for (const SortEntry& entry : entries)
+		{
+			scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+		}
+		entries.swap(scratch);
+	}
+}
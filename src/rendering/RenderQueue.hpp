@@ -0,0 +1,109 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Material;
+class Mesh;
+
+// Collects one draw packet per mesh each frame, sorts them on a 64-bit key and draws them in that order so
+// objects sharing a program, texture set or mesh are drawn back to back. Key layout, most significant first:
+//   pass (2) | program (10) | texture set (12) | mesh (10) | LOD (2) | depth (28)
+// All meshes of a vertex layout share their arena's VAO, the mesh and LOD keep the packets of one mesh level together.
+// Opaque packets are drawn front to back for early-Z, transparent ones back to front.
+// Packets of the same mesh, level of detail and material end up next to each other after sorting and are drawn as one instanced
+// draw, their transforms are streamed into an instance buffer the vertex shader reads at INSTANCE_ATTRIBUTE.
+// Consecutive draws from the same geometry arena with the same material and textures are merged further: into one
+// glMultiDrawElementsIndirect when GL 4.3 is available, otherwise into one glMultiDrawElementsBaseVertex as long
+// as they share their transform (the submeshes of one object).
+// With the depth pre-pass enabled the opaque batches are drawn twice: depth only with an alpha tested position
+// program, then shaded with GL_EQUAL and depth writes off, each in its own GPU pass so both can be measured.
+class RenderQueue
+{
+public:
+	enum Pass { OPAQUE_PASS = 0, TRANSPARENT_PASS = 1 };
+
+	// first of the four attribute locations holding the per-instance transform columns
+	static const GLuint INSTANCE_ATTRIBUTE = 7;
+
+	struct DrawPacket
+	{
+		Material* material;
+		Mesh* mesh;
+		// index into mesh->lods
+		unsigned int lod;
+		glm::mat4 transform;
+	};
+
+	// checks for multi-draw indirect and loads the depth pre-pass program, needs a current context
+	void Init();
+	void SetDepthPrepass(bool enabled) { depthPrepass = enabled; }
+
+	// clears last frame's packets, depth is measured from viewPosition
+	void Begin(const glm::vec3& viewPosition);
+	void Submit(Pass pass, const DrawPacket& packet);
+	void Execute();
+
+private:
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t packet;
+	};
+
+	// layout of GL_DRAW_INDIRECT_BUFFER entries, also used as the draw description on the GL 3.3 path
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// draws that go out as a single call, firstEntry is the sorted entry whose state they use
+	struct Batch
+	{
+		size_t firstEntry;
+		size_t firstCommand;
+		GLsizei commandCount;
+	};
+
+	glm::vec3 viewPosition;
+	std::vector<DrawPacket> packets;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+
+	GLuint instanceBuffer = 0;
+	size_t instanceCapacity = 0;
+	std::vector<glm::mat4> instanceData;
+
+	bool multiDrawIndirect = false;
+	GLuint indirectBuffer = 0;
+	size_t indirectCapacity = 0;
+	std::vector<DrawCommand> commands;
+	std::vector<Batch> batches;
+	std::vector<GLsizei> multiCounts;
+	std::vector<const void*> multiOffsets;
+	std::vector<GLint> multiBaseVertices;
+
+	bool depthPrepass = false;
+	GLuint depthProgram = 0;
+
+	// GL names and meshes are not dense, the key stores compact ids handed out the first time one is seen
+	std::unordered_map<GLuint, uint64_t> programIDs;
+	std::unordered_map<const Mesh*, uint64_t> meshIDs;
+
+	template <typename Name>
+	static uint64_t compactID(std::unordered_map<Name, uint64_t>& ids, Name name);
+	static uint64_t depthBits(float distanceSquared);
+	void radixSort();
+	void uploadInstances();
+	void buildBatches();
+	void uploadCommands();
+	void drawBatch(const Batch& batch);
+	void drawDepth();
+	void applyPassState(Pass pass);
+};
@@ -0,0 +1,221 @@
+#include "SceneCuller.hpp"
+#include "RenderQueue.hpp"
+#include "../Objects/RenderObject.hpp"
+#include "../core/Profiler.hpp"
+#include <algorithm>
+#include <cfloat>
+
+const float SceneCuller::LOD_SCREEN_SIZES[Mesh::MAX_LODS - 1] = { 240.0f, 120.0f, 60.0f };
+const float SceneCuller::LOD_HYSTERESIS = 0.15f;
+const float SceneCuller::MIN_SCREEN_SIZE = 3.0f;
+
+void SceneCuller::SphereBatch::Clear()
+{
+	x.clear();
+	y.clear();
+	z.clear();
+	radius.clear();
+}
+
+void SceneCuller::SphereBatch::Add(const BoundingSphere& sphere)
+{
+	x.push_back(sphere.center.x);
+	y.push_back(sphere.center.y);
+	z.push_back(sphere.center.z);
+	radius.push_back(sphere.radius);
+}
+
+size_t SceneCuller::SphereBatch::Cull(const Frustum& frustum)
+{
+	visible.resize(x.size());
+	if (x.empty()) { return 0; }
+	return frustum.CullSpheres(x.data(), y.data(), z.data(), radius.data(), x.size(), visible.data());
+}
+
+void SceneCuller::Add(RenderObject* object, bool isStatic)
+{
+	if (!object || handles.count(object)) { return; }
+
+	object->RefreshTransform();
+	int handle = hierarchy.Add(object->WorldBounds());
+	if (handle >= (int)objects.size()) { objects.resize(handle + 1, nullptr); }
+	objects[handle] = object;
+	handles[object] = handle;
+	if (handle >= (int)lodLevels.size()) { lodLevels.resize(handle + 1, 0); }
+	lodLevels[handle] = 0;
+	meshCount += object->GetModel()->meshes.size();
+
+	if (!isStatic) { dynamicObjects.push_back(object); }
+}
+
+void SceneCuller::Remove(RenderObject* object)
+{
+	auto found = handles.find(object);
+	if (found == handles.end()) { return; }
+
+	hierarchy.Remove(found->second);
+	objects[found->second] = nullptr;
+	handles.erase(found);
+	meshCount -= object->GetModel()->meshes.size();
+	dynamicObjects.erase(std::remove(dynamicObjects.begin(), dynamicObjects.end(), object), dynamicObjects.end());
+}
+
+void SceneCuller::Moved(RenderObject* object)
+{
+	auto found = handles.find(object);
+	if (found != handles.end() && object->RefreshTransform())
+	{
+		hierarchy.Update(found->second, object->WorldBounds());
+	}
+}
+
+void SceneCuller::Cull(const Frustum& frustum, const glm::vec3& viewPosition, float screenScale, RenderQueue& queue)
+{
+	PROFILE_SCOPE("SceneCuller::Cull");
+	static const int objectsVisiblePhase = Profiler::RegisterPhase("cull objects visible", Profiler::Unit::Count);
+	static const int objectsCulledPhase = Profiler::RegisterPhase("cull objects culled", Profiler::Unit::Count);
+	static const int objectsOccludedPhase = Profiler::RegisterPhase("cull objects occluded", Profiler::Unit::Count);
+	static const int objectsSmallPhase = Profiler::RegisterPhase("cull objects too small", Profiler::Unit::Count);
+	static const int meshesVisiblePhase = Profiler::RegisterPhase("cull meshes visible", Profiler::Unit::Count);
+	static const int meshesCulledPhase = Profiler::RegisterPhase("cull meshes culled", Profiler::Unit::Count);
+	static const int nodesVisitedPhase = Profiler::RegisterPhase("cull bvh nodes visited", Profiler::Unit::Count);
+
+	for (RenderObject* object : dynamicObjects)
+	{
+		Moved(object);
+	}
+	hierarchy.Refit();
+
+	insideItems.clear();
+	partialItems.clear();
+	hierarchy.QueryFrustum(frustum, insideItems, partialItems);
+
+	// everything under a node inside the frustum is visible down to its meshes
+	candidates.clear();
+	for (int item : insideItems)
+	{
+		candidates.push_back({ item, objects[item], -1, 0 });
+	}
+
+	objectSpheres.Clear();
+	for (int item : partialItems)
+	{
+		objectSpheres.Add(objects[item]->WorldSphere());
+	}
+	objectSpheres.Cull(frustum);
+
+	// a single mesh shares the object's sphere, only models with several meshes get a second test
+	meshSpheres.Clear();
+	for (size_t i = 0; i < partialItems.size(); i++)
+	{
+		if (!objectSpheres.visible[i]) { continue; }
+
+		int item = partialItems[i];
+		RenderObject* object = objects[item];
+		const std::vector<Mesh>& meshes = object->GetModel()->meshes;
+		if (meshes.size() < 2)
+		{
+			candidates.push_back({ item, object, -1, 0 });
+			continue;
+		}
+
+		candidates.push_back({ item, object, (int)meshSpheres.x.size(), 0 });
+		for (const Mesh& mesh : meshes)
+		{
+			meshSpheres.Add(TransformSphere(mesh.sphere, object->Transform()));
+		}
+	}
+	meshSpheres.Cull(frustum);
+
+	// too small to contribute anything, or drawn at the level matching their size on screen
+	candidateVisible.assign(candidates.size(), 1);
+	size_t smallObjects = 0;
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		Candidate& candidate = candidates[i];
+		const BoundingSphere& sphere = candidate.object->WorldSphere();
+		float distance = glm::length(sphere.center - viewPosition);
+		float screenSize = distance > sphere.radius ? 2.0f * sphere.radius * screenScale / distance : FLT_MAX;
+
+		if (screenSize < MIN_SCREEN_SIZE)
+		{
+			candidateVisible[i] = 0;
+			smallObjects++;
+			continue;
+		}
+		candidate.lod = selectLod(candidate.item, screenSize);
+	}
+
+	size_t occludedObjects = 0;
+	if (occlusion)
+	{
+		candidateBounds.clear();
+		for (const Candidate& candidate : candidates)
+		{
+			candidateBounds.push_back(candidate.object->WorldBounds());
+		}
+		occludedObjects = occlusion->Test(candidateBounds.data(), candidateBounds.size(), candidateVisible.data());
+	}
+
+	size_t visibleObjects = 0, visibleMeshes = 0;
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		if (!candidateVisible[i]) { continue; }
+
+		const Candidate& candidate = candidates[i];
+		const unsigned char* meshVisible = candidate.firstMesh >= 0 ? &meshSpheres.visible[candidate.firstMesh] : nullptr;
+		visibleMeshes += candidate.object->Submit(queue, candidate.object->Transform(), meshVisible, candidate.lod);
+		visibleObjects++;
+	}
+
+	Profiler::AddCount(objectsVisiblePhase, (double)visibleObjects);
+	Profiler::AddCount(objectsCulledPhase, (double)(hierarchy.ItemCount() - visibleObjects - occludedObjects - smallObjects));
+	Profiler::AddCount(objectsOccludedPhase, (double)occludedObjects);
+	Profiler::AddCount(objectsSmallPhase, (double)smallObjects);
+	Profiler::AddCount(meshesVisiblePhase, (double)visibleMeshes);
+	Profiler::AddCount(meshesCulledPhase, (double)(meshCount - visibleMeshes));
+	Profiler::AddCount(nodesVisitedPhase, (double)hierarchy.VisitedNodes());
+}
+
+unsigned int SceneCuller::selectLod(int item, float screenSize)
+{
+	// an object only moves to the next level once it is clearly past the threshold, so one sitting right on it
+	// doesn't flip between levels every frame
+	unsigned int lod = lodLevels[item];
+	while (lod < Mesh::MAX_LODS - 1 && screenSize < LOD_SCREEN_SIZES[lod] * (1.0f - LOD_HYSTERESIS)) { lod++; }
+	while (lod > 0 && screenSize > LOD_SCREEN_SIZES[lod - 1] * (1.0f + LOD_HYSTERESIS)) { lod--; }
+
+	lodLevels[item] = (unsigned char)lod;
+	return lod;
+}
+
+void SceneCuller::collect(const std::vector<int>& items, std::vector<RenderObject*>& results) const
+{
+	for (int item : items)
+	{
+		results.push_back(objects[item]);
+	}
+}
+
+void SceneCuller::QuerySphere(const BoundingSphere& sphere, std::vector<RenderObject*>& results)
+{
+	hierarchy.Refit();
+	queryItems.clear();
+	hierarchy.QuerySphere(sphere, queryItems);
+	collect(queryItems, results);
+}
+
+void SceneCuller::QueryBox(const AABB& box, std::vector<RenderObject*>& results)
+{
+	hierarchy.Refit();
+	queryItems.clear();
+	hierarchy.QueryBox(box, queryItems);
+	collect(queryItems, results);
+}
+
+RenderObject* SceneCuller::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance)
+{
+	hierarchy.Refit();
+	int item = hierarchy.Raycast(origin, direction, maxDistance, distance);
+	return item >= 0 ? objects[item] : nullptr;
+}
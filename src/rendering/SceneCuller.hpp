@@ -0,0 +1,88 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+#include "Frustum.hpp"
+#include "BoundingVolumeHierarchy.hpp"
+#include "IOcclusionTest.hpp"
+#include "mesh.hpp"
+
+class RenderObject;
+class RenderQueue;
+
+// Keeps the world bounds of the registered render objects in a bounding volume hierarchy and culls them against
+// the frustum before they reach the render queue. Subtrees completely inside the frustum are submitted untested,
+// the objects of leaves crossing it have their bounding spheres tested four at a time and the submeshes of
+// objects that survive are tested the same way in a second batch. When an occlusion test is set the boxes of
+// what is left are tested against it before anything is submitted. Visible and culled counts go to the Profiler.
+// Static objects cost nothing per frame, after moving one call Moved. Dynamic ones are checked for a changed
+// transform every frame.
+// Every object that is left picks a level of detail from the size of its bounding sphere on screen, objects
+// smaller than MIN_SCREEN_SIZE pixels are dropped altogether.
+class SceneCuller
+{
+public:
+	// screen diameter in pixels below which an object switches from level i to level i + 1
+	static const float LOD_SCREEN_SIZES[Mesh::MAX_LODS - 1];
+	// fraction an object has to pass a threshold by before it switches
+	static const float LOD_HYSTERESIS;
+	static const float MIN_SCREEN_SIZE;
+
+	void Add(RenderObject* object, bool isStatic = true);
+	void Remove(RenderObject* object);
+	void Moved(RenderObject* object);
+
+	// nullptr turns occlusion culling off, the test has to be prepared for the frame before Cull
+	void SetOcclusion(IOcclusionTest* test) { occlusion = test; }
+
+	// screenScale is the screen size in pixels of one world unit at distance one: projection[1][1] * height / 2
+	void Cull(const Frustum& frustum, const glm::vec3& viewPosition, float screenScale, RenderQueue& queue);
+
+	void QuerySphere(const BoundingSphere& sphere, std::vector<RenderObject*>& results);
+	void QueryBox(const AABB& box, std::vector<RenderObject*>& results);
+	// closest object whose bounds the ray hits, nullptr when there is none
+	RenderObject* Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance);
+
+private:
+	// spheres in structure of arrays form, the layout Frustum::CullSpheres reads
+	struct SphereBatch
+	{
+		std::vector<float> x, y, z, radius;
+		std::vector<unsigned char> visible;
+
+		void Clear();
+		void Add(const BoundingSphere& sphere);
+		size_t Cull(const Frustum& frustum);
+	};
+
+	// an object that passed the frustum test, firstMesh is its entry in meshSpheres or -1 to draw all meshes
+	struct Candidate
+	{
+		int item;
+		RenderObject* object;
+		int firstMesh;
+		unsigned int lod;
+	};
+
+	BoundingVolumeHierarchy hierarchy;
+	IOcclusionTest* occlusion = nullptr;
+	// indexed by hierarchy handle
+	std::vector<RenderObject*> objects;
+	std::unordered_map<RenderObject*, int> handles;
+	std::vector<RenderObject*> dynamicObjects;
+	// current level of detail per hierarchy handle
+	std::vector<unsigned char> lodLevels;
+	size_t meshCount = 0;
+
+	std::vector<int> insideItems;
+	std::vector<int> partialItems;
+	std::vector<int> queryItems;
+	SphereBatch objectSpheres;
+	SphereBatch meshSpheres;
+	std::vector<Candidate> candidates;
+	std::vector<AABB> candidateBounds;
+	std::vector<unsigned char> candidateVisible;
+
+	unsigned int selectLod(int item, float screenSize);
+	void collect(const std::vector<int>& items, std::vector<RenderObject*>& results) const;
+};
@@ -1,5 +1,7 @@
 #include "SkyBox.hpp"
 #include "Material.hpp"
+#include "GpuProfiler.hpp"
+#include "GLState.hpp"
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -11,34 +13,28 @@
 SkyBox::SkyBox() 
 {
 	Material::createProgram(skyProgramID, "assets/shaders/skyVertex.glsl", "assets/shaders/skyFragment.glsl");
+	transformUniform = Material::GetUniform<glm::mat4>(skyProgramID, "transform");
+
 	createCubeMesh();
 }
 
-void SkyBox::Update()
+void SkyBox::Draw()
 {
+	GPU_PASS_SCOPE("sky");
+
 	glm::mat4 transform = glm::mat4(1.0f);
 	transform = glm::translate(transform, Camera::Instance()->position);
 	transform = glm::scale(transform, glm::vec3(10.0f, 10.0f, 10.0f));
 
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH);
-	glDisable(GL_DEPTH_TEST);
+	GLState::Disable(GL_CULL_FACE);
+	GLState::Disable(GL_DEPTH_TEST);
 
-	glUseProgram(skyProgramID);
+	GLState::UseProgram(skyProgramID);
 
-	glUniformMatrix4fv(glGetUniformLocation(skyProgramID, "transform"), 1, GL_FALSE, glm::value_ptr(transform));
-	glUniformMatrix4fv(glGetUniformLocation(skyProgramID, "view"), 1, GL_FALSE, glm::value_ptr(Camera::Instance()->view));
-	glUniformMatrix4fv(glGetUniformLocation(skyProgramID, "projection"), 1, GL_FALSE, glm::value_ptr(Camera::Instance()->projection));
+	transformUniform.Set(transform);
 
-	glUniform3fv(glGetUniformLocation(skyProgramID, "cameraPosition"), 1, glm::value_ptr(Camera::Instance()->position));
-	glUniform3fv(glGetUniformLocation(skyProgramID, "lightDirection"), 1, glm::value_ptr(Camera::Instance()->lightDirection));
-
-	glBindVertexArray(boxVAO);
+	GLState::BindVertexArray(boxVAO);
 	glDrawElements(GL_TRIANGLES, boxNumIndices, GL_UNSIGNED_INT, 0);
-
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_DEPTH);
-	glEnable(GL_DEPTH_TEST);
 }
 
 void SkyBox::createCubeMesh()
@@ -108,7 +104,7 @@ void SkyBox::createCubeMesh()
 	boxNumIndices = sizeof(indices) / sizeof(int);
 
 	glGenVertexArrays(1, &boxVAO);
-	glBindVertexArray(boxVAO);
+	GLState::BindVertexArray(boxVAO);
 
 	GLuint VBO;
 	glGenBuffers(1, &VBO);
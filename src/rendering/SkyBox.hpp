@@ -1,17 +1,20 @@
 #pragma once
 #include <glad/glad.h>
-#include "../Objects/IUpdate.hpp"
+#include <glm/glm.hpp>
+#include "Uniform.hpp"
 
-class SkyBox : public IUpdate
+class SkyBox
 {
 private:
 	GLuint skyProgramID;
 	GLuint boxVAO;
 	int boxNumVertices;
 	int boxNumIndices;
+	Uniform<glm::mat4> transformUniform;
 	void createCubeMesh();
 
 public:
 	SkyBox();
-	void Update();
+	// the sky pass of the frame graph, around the camera with depth testing off
+	void Draw();
 };
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "Terrain.hpp"
+#include "Material.hpp"
+#include "GpuProfiler.hpp"
+#include "GLState.hpp"
+#include "TextureArrayBuilder.hpp"
+#include "../core/Profiler.hpp"
+#include "../../stb_image.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+const float Terrain::SHADER_HEIGHT_SCALE = 300.0f;
+
+Terrain::Terrain(const char* heightmap, float hScale, float xzScale) : heightScale(hScale), xzScale(xzScale)
+{
+	Material::createProgram(terrainProgramID, "assets/shaders/terrainVertex.glsl", "assets/shaders/terrainFragment.glsl");
+
+	GLState::UseProgram(terrainProgramID);
+	Material::GetUniform<int>(terrainProgramID, "mainTex").Set(0);
+	Material::GetUniform<int>(terrainProgramID, "normalTex").Set(1);
+
+	Material::GetUniform<int>(terrainProgramID, "splatLayers").Set(2);
+
+	transformUniform = Material::GetUniform<glm::mat4>(terrainProgramID, "transform");
+
+	Material::createProgram(depthProgramID, "assets/shaders/terrainDepthVertex.glsl", "assets/shaders/depthFragment.glsl");
+	GLState::UseProgram(depthProgramID);
+	Material::GetUniform<int>(depthProgramID, "mainTex").Set(0);
+	depthTransformUniform = Material::GetUniform<glm::mat4>(depthProgramID, "transform");
+
+	generatePlane(heightmap, hScale, xzScale);
+	heightNormalID = MaterialTexture::loadTexture("assets/textures/heightmapNormal.png", TextureCache::NORMAL, this);
+
+	// one array instead of five textures, the shader only samples the layers that contribute to a pixel
+	TextureArrayBuilder splatBuilder(SPLAT_LAYER_SIZE, SPLAT_LAYER_SIZE);
+	splatBuilder.Add("assets/textures/dirt.jpg");
+	splatBuilder.Add("assets/textures/sand.jpg");
+	splatBuilder.Add("assets/textures/grass.png");
+	splatBuilder.Add("assets/textures/rock.jpg");
+	splatBuilder.Add("assets/textures/snow.jpg");
+	splatLayers = splatBuilder.Build();
+}
+
+Terrain::~Terrain()
+{
+	MaterialTexture::releaseTexture(heightNormalID);
+}
+
+void Terrain::Draw()
+{
+	GLState::Enable(GL_CULL_FACE);
+	GLState::CullFace(GL_BACK);
+	GLState::Enable(GL_DEPTH_TEST);
+
+	glm::mat4 transform = glm::mat4(1.0f);
+
+	if (depthPrepass)
+	{
+		drawDepth(transform);
+	}
+
+	GPU_PASS_SCOPE("terrain");
+	static const int texturePhase = Profiler::RegisterPhase("terrain texture binds", Profiler::Unit::Count);
+	unsigned int texturesBound = GLState::TextureBinds();
+
+	// after the pre-pass only the nearest fragment of every pixel passes, its depth is already written
+	GLState::DepthFunc(depthPrepass ? GL_EQUAL : GL_LESS);
+	GLState::DepthMask(depthPrepass ? GL_FALSE : GL_TRUE);
+
+	GLState::UseProgram(terrainProgramID);
+
+	transformUniform.Set(transform);
+
+	GLState::BindTextureUnit(0, GL_TEXTURE_2D, heightMapID);
+	GLState::BindTextureUnit(1, GL_TEXTURE_2D, heightNormalID);
+	GLState::BindTextureUnit(2, GL_TEXTURE_2D_ARRAY, splatLayers);
+	Profiler::AddCount(texturePhase, GLState::TextureBinds() - texturesBound);
+
+	GLState::BindVertexArray(terrainVAO);
+	glDrawElements(GL_TRIANGLES, terrainIndexCount, GL_UNSIGNED_INT, 0);
+
+	GLState::DepthFunc(GL_LESS);
+	GLState::DepthMask(GL_TRUE);
+}
+
+void Terrain::drawDepth(const glm::mat4& transform)
+{
+	GPU_PASS_SCOPE("terrain depth");
+
+	GLState::DepthFunc(GL_LESS);
+	GLState::DepthMask(GL_TRUE);
+	GLState::ColorMask(GL_FALSE);
+
+	GLState::UseProgram(depthProgramID);
+	depthTransformUniform.Set(transform);
+	GLState::BindTextureUnit(0, GL_TEXTURE_2D, heightMapID);
+
+	GLState::BindVertexArray(terrainVAO);
+	glDrawElements(GL_TRIANGLES, terrainIndexCount, GL_UNSIGNED_INT, 0);
+
+	GLState::ColorMask(GL_TRUE);
+}
+
+float Terrain::HeightAt(float x, float z) const
+{
+	if (!heightMapData) { return 0.0f; }
+
+	// bilinear like the displacement lookup in terrainVertex.glsl
+	float u = x / xzScale;
+	float v = z / xzScale;
+	if (u < 0.0f || v < 0.0f || u > heightMapWidth - 1 || v > heightMapHeight - 1) { return 0.0f; }
+
+	int x0 = (int)u, z0 = (int)v;
+	int x1 = x0 + 1 < heightMapWidth ? x0 + 1 : x0;
+	int z1 = z0 + 1 < heightMapHeight ? z0 + 1 : z0;
+	float fx = u - x0, fz = v - z0;
+
+	const int comp = 4;
+	float h00 = heightMapData[(z0 * heightMapWidth + x0) * comp];
+	float h10 = heightMapData[(z0 * heightMapWidth + x1) * comp];
+	float h01 = heightMapData[(z1 * heightMapWidth + x0) * comp];
+	float h11 = heightMapData[(z1 * heightMapWidth + x1) * comp];
+	float h = (h00 * (1.0f - fx) + h10 * fx) * (1.0f - fz) + (h01 * (1.0f - fx) + h11 * fx) * fz;
+
+	return (h / 255.0f) * (heightScale + SHADER_HEIGHT_SCALE);
+}
+
+std::vector<glm::vec3> Terrain::ScatterPositions(float chance, float minHeight, float maxHeight) const
+{
+	std::vector<glm::vec3> positions;
+	if (!heightMapData) { return positions; }
+
+	int threshold = (int)(chance * 10000.0f);
+	for (int i = 0; i < heightMapWidth * heightMapHeight; i++)
+	{
+		if (std::rand() % 10000 >= threshold) { continue; }
+
+		float x = (i % heightMapWidth) * xzScale;
+		float z = (i / heightMapWidth) * xzScale;
+		float y = HeightAt(x, z);
+		if (y >= minHeight && y <= maxHeight)
+		{
+			positions.push_back(glm::vec3(x, y, z));
+		}
+	}
+	return positions;
+}
+
+void Terrain::BuildOccluder(int step, std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices) const
+{
+	positions.clear();
+	indices.clear();
+	if (!heightMapData || step < 1) { return; }
+
+	const int comp = 4;
+	int columns = (heightMapWidth - 1) / step + 1;
+	int rows = (heightMapHeight - 1) / step + 1;
+	for (int row = 0; row < rows; row++)
+	{
+		for (int column = 0; column < columns; column++)
+		{
+			int x = column * step, z = row * step;
+
+			// the cells on either side reach step texels away
+			unsigned char lowest = 255;
+			for (int sampleZ = std::max(0, z - step); sampleZ <= std::min(heightMapHeight - 1, z + step); sampleZ++)
+			{
+				for (int sampleX = std::max(0, x - step); sampleX <= std::min(heightMapWidth - 1, x + step); sampleX++)
+				{
+					lowest = std::min(lowest, heightMapData[(sampleZ * heightMapWidth + sampleX) * comp]);
+				}
+			}
+
+			float y = (lowest / 255.0f) * (heightScale + SHADER_HEIGHT_SCALE);
+			positions.push_back(glm::vec3(x * xzScale, y, z * xzScale));
+		}
+	}
+
+	for (int row = 0; row + 1 < rows; row++)
+	{
+		for (int column = 0; column + 1 < columns; column++)
+		{
+			unsigned int vertex = row * columns + column;
+			indices.push_back(vertex);
+			indices.push_back(vertex + columns);
+			indices.push_back(vertex + columns + 1);
+
+			indices.push_back(vertex);
+			indices.push_back(vertex + columns + 1);
+			indices.push_back(vertex + 1);
+		}
+	}
+}
+
+void Terrain::generatePlane(const char* heightmap, float hScale, float xzScale)
+{
+	const int comp = 4;
+	int channels;
+	heightMapData = stbi_load(heightmap, &heightMapWidth, &heightMapHeight, &channels, comp);
+	if (!heightMapData)
+	{
+		std::cout << "Error Loading Heightmap Data" << std::endl;
+		terrainVAO = 0;
+		terrainIndexCount = 0;
+		return;
+	}
+
+	int width = heightMapWidth;
+	int height = heightMapHeight;
+
+	glGenTextures(1, &heightMapID);
+	GLState::BindTexture(GL_TEXTURE_2D, heightMapID);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, heightMapData);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	GLState::BindTexture(GL_TEXTURE_2D, 0);
+
+	int stride = 8;
+	float* vertices = new float[(width * height) * stride];
+	unsigned int* indices = new unsigned int[(width - 1) * (height - 1) * 6];
+
+	int index = 0;
+	for (int i = 0; i < (width * height); i++)
+	{
+		int x = i % width;
+		int z = i / width;
+
+		float vertexH = ((float)heightMapData[i * comp] / 255.0f) * hScale;
+
+		// position
+		vertices[index++] = x * xzScale;
+		vertices[index++] = vertexH;
+		vertices[index++] = z * xzScale;
+
+		// normal
+		vertices[index++] = 0;
+		vertices[index++] = 1;
+		vertices[index++] = 0;
+
+		// uv
+		vertices[index++] = x / (float)width;
+		vertices[index++] = z / (float)height;
+	}
+
+	index = 0;
+	for (int i = 0; i < (width - 1) * (height - 1); i++)
+	{
+		int x = i % (width - 1);
+		int z = i / (width - 1);
+
+		int vertex = z * width + x;
+
+		indices[index++] = vertex;
+		indices[index++] = vertex + width;
+		indices[index++] = vertex + width + 1;
+
+		indices[index++] = vertex;
+		indices[index++] = vertex + width + 1;
+		indices[index++] = vertex + 1;
+	}
+
+	unsigned int vertSize = (width * height) * stride * sizeof(float);
+	terrainIndexCount = ((width - 1) * (height - 1) * 6);
+
+	unsigned int VBO, EBO;
+	glGenVertexArrays(1, &terrainVAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+
+	GLState::BindVertexArray(terrainVAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertSize, vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, terrainIndexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+
+	// position
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * stride, 0);
+	glEnableVertexAttribArray(0);
+	// normal
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * stride, (void*)(sizeof(float) * 3));
+	glEnableVertexAttribArray(1);
+	// uv
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * stride, (void*)(sizeof(float) * 6));
+	glEnableVertexAttribArray(2);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	GLState::BindVertexArray(0);
+
+	delete[] vertices;
+	delete[] indices;
+}
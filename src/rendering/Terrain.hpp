@@ -0,0 +1,63 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Uniform.hpp"
+
+// Heightmap terrain, ported from renderTerrain/GeneratePlane in main_homework.cpp.
+class Terrain
+{
+private:
+	GLuint terrainProgramID;
+	GLuint depthProgramID;
+	bool depthPrepass = false;
+	GLuint terrainVAO;
+	unsigned int terrainIndexCount;
+
+	GLuint heightMapID, heightNormalID;
+	// the splat textures in SplatLayer order
+	GLuint splatLayers;
+
+	Uniform<glm::mat4> transformUniform;
+	Uniform<glm::mat4> depthTransformUniform;
+
+	float heightScale, xzScale;
+
+	void generatePlane(const char* heightmap, float hScale, float xzScale);
+	void drawDepth(const glm::mat4& transform);
+
+public:
+	unsigned char* heightMapData;
+	int heightMapWidth, heightMapHeight;
+
+	// terrainVertex.glsl displaces the mesh by this much on top of the height baked into the vertices
+	static const float SHADER_HEIGHT_SCALE;
+
+	// layers of the splat texture array, terrainFragment.glsl indexes them with the same numbers
+	enum SplatLayer { DIRT_LAYER, SAND_LAYER, GRASS_LAYER, ROCK_LAYER, SNOW_LAYER, SPLAT_LAYER_COUNT };
+	// every splat texture is resized to this on import
+	static const int SPLAT_LAYER_SIZE = 1024;
+
+	Terrain(const char* heightmap, float hScale, float xzScale);
+	// gives the registry texture back
+	~Terrain();
+	Terrain(const Terrain&) = delete;
+	Terrain& operator=(const Terrain&) = delete;
+	// the terrain pass of the frame graph
+	void Draw();
+
+	// lays down depth with a position only program first and shades with GL_EQUAL, so the noise and the seven
+	// texture lookups run once per pixel instead of once per overlapping fragment
+	void SetDepthPrepass(bool enabled) { depthPrepass = enabled; }
+
+	// world height of the rendered terrain at a world xz position, 0 outside the heightmap
+	float HeightAt(float x, float z) const;
+
+	// picks heightmap texels with the given chance and returns the ones whose height lies in [minHeight, maxHeight],
+	// the same scattering main_homework.cpp did for its trees
+	std::vector<glm::vec3> ScatterPositions(float chance, float minHeight, float maxHeight) const;
+
+	// coarse world space mesh with a vertex every step texels for the software occlusion rasterizer. Every vertex
+	// takes the lowest height around it, so the mesh stays below the rendered surface and never hides too much
+	void BuildOccluder(int step, std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices) const;
+};
@@ -0,0 +1,114 @@
+#include "TextureArrayBuilder.hpp"
+#include "../../stb_image.h"
+#include "GLState.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+int TextureArrayBuilder::Add(const char* path)
+{
+	int imageWidth, imageHeight, numChannels;
+	unsigned char* data = stbi_load(path, &imageWidth, &imageHeight, &numChannels, 4);
+
+	if (width == 0 || height == 0)
+	{
+		width = data ? imageWidth : 1;
+		height = data ? imageHeight : 1;
+	}
+
+	size_t layerSize = (size_t)width * height * 4;
+	pixels.resize(pixels.size() + layerSize, 0);
+	unsigned char* layer = &pixels[pixels.size() - layerSize];
+
+	if (!data)
+	{
+		std::cout << "Error loading texture: " << path << std::endl;
+		layerCount++;
+		return -1;
+	}
+
+	if (imageWidth == width && imageHeight == height)
+	{
+		std::copy(data, data + layerSize, layer);
+	}
+	else
+	{
+		std::cout << "Resizing " << path << " from " << imageWidth << "x" << imageHeight << " to " << width << "x" << height << " for its texture array" << std::endl;
+		resize(data, imageWidth, imageHeight, layer, width, height);
+	}
+
+	stbi_image_free(data);
+	return layerCount++;
+}
+
+GLuint TextureArrayBuilder::Build() const
+{
+	if (layerCount == 0) { return 0; }
+
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	GLState::BindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+	GLState::BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return textureID;
+}
+
+void TextureArrayBuilder::resize(const unsigned char* source, int sourceWidth, int sourceHeight, unsigned char* destination, int destinationWidth, int destinationHeight)
+{
+	float scaleX = (float)sourceWidth / (float)destinationWidth;
+	float scaleY = (float)sourceHeight / (float)destinationHeight;
+	bool shrinking = scaleX >= 1.0f && scaleY >= 1.0f;
+
+	for (int y = 0; y < destinationHeight; y++)
+	{
+		for (int x = 0; x < destinationWidth; x++)
+		{
+			unsigned char* pixel = destination + ((size_t)y * destinationWidth + x) * 4;
+
+			if (shrinking)
+			{
+				// average of the source texels the destination texel covers
+				int x0 = (int)(x * scaleX), x1 = std::max(x0 + 1, std::min(sourceWidth, (int)std::ceil((x + 1) * scaleX)));
+				int y0 = (int)(y * scaleY), y1 = std::max(y0 + 1, std::min(sourceHeight, (int)std::ceil((y + 1) * scaleY)));
+				unsigned int sum[4] = { 0, 0, 0, 0 };
+				for (int sy = y0; sy < y1; sy++)
+				{
+					for (int sx = x0; sx < x1; sx++)
+					{
+						const unsigned char* texel = source + ((size_t)sy * sourceWidth + sx) * 4;
+						for (int c = 0; c < 4; c++) { sum[c] += texel[c]; }
+					}
+				}
+				unsigned int count = (unsigned int)((x1 - x0) * (y1 - y0));
+				for (int c = 0; c < 4; c++) { pixel[c] = (unsigned char)((sum[c] + count / 2) / count); }
+				continue;
+			}
+
+			// bilinear between the four nearest texel centers, clamped at the edges
+			float sx = std::min(std::max((x + 0.5f) * scaleX - 0.5f, 0.0f), (float)(sourceWidth - 1));
+			float sy = std::min(std::max((y + 0.5f) * scaleY - 0.5f, 0.0f), (float)(sourceHeight - 1));
+			int ix = (int)sx, iy = (int)sy;
+			int nx = std::min(ix + 1, sourceWidth - 1), ny = std::min(iy + 1, sourceHeight - 1);
+			float fx = sx - ix, fy = sy - iy;
+
+			const unsigned char* t00 = source + ((size_t)iy * sourceWidth + ix) * 4;
+			const unsigned char* t10 = source + ((size_t)iy * sourceWidth + nx) * 4;
+			const unsigned char* t01 = source + ((size_t)ny * sourceWidth + ix) * 4;
+			const unsigned char* t11 = source + ((size_t)ny * sourceWidth + nx) * 4;
+			for (int c = 0; c < 4; c++)
+			{
+				float top = t00[c] + (t10[c] - t00[c]) * fx;
+				float bottom = t01[c] + (t11[c] - t01[c]) * fx;
+				pixel[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+			}
+		}
+	}
+}
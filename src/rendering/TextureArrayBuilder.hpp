@@ -0,0 +1,29 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+
+// Packs images into the layers of one GL_TEXTURE_2D_ARRAY, so a shader picks them by index from a single binding.
+// Every layer is stored as RGBA8 at the size of the array; images of another size are resized on import,
+// box filtered when they shrink and bilinear when they grow.
+class TextureArrayBuilder
+{
+public:
+	// without a size the array takes the size of the first layer
+	explicit TextureArrayBuilder(int width = 0, int height = 0) : width(width), height(height) {}
+
+	// returns the layer index. An image that can't be loaded still takes a (black) layer so the indices of the
+	// following ones don't shift, -1 is returned for it
+	int Add(const char* path);
+	int LayerCount() const { return layerCount; }
+
+	// uploads all layers with a full mip chain, returns 0 when there is nothing to upload
+	GLuint Build() const;
+
+private:
+	int width, height;
+	int layerCount = 0;
+	// RGBA8, one layer after the other
+	std::vector<unsigned char> pixels;
+
+	static void resize(const unsigned char* source, int sourceWidth, int sourceHeight, unsigned char* destination, int destinationWidth, int destinationHeight);
+};
@@ -0,0 +1,317 @@
+#include "TextureCache.hpp"
+#include "../../stb_image.h"
+#include "../core/File.hpp"
+#include "GLExtensions.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// EXT_texture_compression_s3tc, glad was generated without extensions
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+
+const char* const TextureCache::CACHE_DIRECTORY = "cache/textures";
+const uint32_t TextureCache::MAGIC = 0x43585447; // "GTXC"
+const uint32_t TextureCache::VERSION = 1;
+
+bool TextureCache::compression = true;
+int TextureCache::s3tcSupported = -1;
+std::mutex TextureCache::statisticsMutex;
+size_t TextureCache::textureCount = 0;
+size_t TextureCache::cacheHits = 0;
+size_t TextureCache::encodedCount = 0;
+size_t TextureCache::gpuBytes = 0;
+size_t TextureCache::uncompressedBytes = 0;
+double TextureCache::totalMilliseconds = 0.0;
+
+size_t TextureCache::Image::LevelOffset(int level) const
+{
+	size_t offset = sizeof(FileHeader);
+	for (int i = 0; i < level; i++)
+	{
+		offset += BlockCompressor::LevelSize(format, LevelWidth(i), LevelHeight(i));
+	}
+	return offset;
+}
+
+void TextureCache::Init()
+{
+	if (s3tcSupported < 0)
+	{
+		s3tcSupported = GLExtensions::Supported("GL_EXT_texture_compression_s3tc") ? 1 : 0;
+	}
+}
+
+bool TextureCache::Prepare(const char* path, Kind kind, Image& image)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::vector<unsigned char> source;
+	if (!readFile(path, source))
+	{
+		std::cout << "Error loading texture: " << path << std::endl;
+		return false;
+	}
+
+	uint64_t key = contentKey(source, kind);
+
+	char fileName[32];
+	std::snprintf(fileName, sizeof(fileName), "/%016llx.gtex", (unsigned long long)key);
+	std::string cachePath = std::string(CACHE_DIRECTORY) + fileName;
+
+	std::vector<unsigned char> file;
+	bool hit = readFile(cachePath, file) && parse(file, key, image);
+
+	if (!hit)
+	{
+		if (!encode(source, kind, key, file))
+		{
+			std::cout << "Error loading texture: " << path << std::endl;
+			return false;
+		}
+
+		File::CreateDirectories(CACHE_DIRECTORY);
+		if (!File::WriteAtomic(cachePath.c_str(), file.data(), file.size()))
+		{
+			std::cout << "WARNING::TEXTURE_CACHE::WRITE_FAILED " << cachePath << std::endl;
+		}
+		parse(file, key, image);
+	}
+
+	std::lock_guard<std::mutex> lock(statisticsMutex);
+	textureCount++;
+	(hit ? cacheHits : encodedCount)++;
+	totalMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+bool TextureCache::ContentKey(const char* path, Kind kind, uint64_t& key, size_t& fileSize)
+{
+	std::vector<unsigned char> source;
+	if (!readFile(path, source)) { return false; }
+
+	key = contentKey(source, kind);
+	fileSize = source.size();
+	return true;
+}
+
+void TextureCache::Upload(const Image& image, GLuint texture, const unsigned char* file)
+{
+	GLState::BindTexture(GL_TEXTURE_2D, texture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levelCount - 1);
+
+	size_t levelGpuBytes = 0, levelUncompressedBytes = 0;
+	for (int i = 0; i < image.levelCount; i++)
+	{
+		int width = image.LevelWidth(i), height = image.LevelHeight(i);
+		size_t size = BlockCompressor::LevelSize(image.format, width, height);
+		// with an unpack buffer bound the pointer is an offset into it
+		const void* pixels = (const void*)((uintptr_t)file + image.LevelOffset(i));
+
+		if (image.format == BlockCompressor::RGBA8)
+		{
+			glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		}
+		else
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat(image.format), width, height, 0, (GLsizei)size, pixels);
+		}
+
+		levelGpuBytes += size;
+		levelUncompressedBytes += (size_t)width * height * 4;
+	}
+
+	GLState::BindTexture(GL_TEXTURE_2D, 0);
+
+	std::lock_guard<std::mutex> lock(statisticsMutex);
+	gpuBytes += levelGpuBytes;
+	uncompressedBytes += levelUncompressedBytes;
+}
+
+GLuint TextureCache::Load(const char* path, Kind kind)
+{
+	Init();
+
+	Image image;
+	if (!Prepare(path, kind, image)) { return 0; }
+
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	Upload(image, textureID, image.file.data());
+	return textureID;
+}
+
+void TextureCache::Report(std::ostream& out)
+{
+	std::lock_guard<std::mutex> lock(statisticsMutex);
+	out << "Texture cache: " << textureCount << " textures, " << cacheHits << " hits, " << encodedCount << " encoded, "
+		<< totalMilliseconds << " ms preparing, " << gpuBytes / 1024 << " KiB on the GPU (" << uncompressedBytes / 1024 << " KiB as RGBA8)"
+		<< (compression ? "" : " (compression disabled)") << std::endl;
+}
+
+bool TextureCache::readFile(const std::string& path, std::vector<unsigned char>& output)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) { return false; }
+
+	std::streamsize size = file.tellg();
+	if (size <= 0) { return false; }
+	file.seekg(0, std::ios::beg);
+
+	output.resize((size_t)size);
+	return (bool)file.read((char*)output.data(), size);
+}
+
+uint64_t TextureCache::contentKey(const std::vector<unsigned char>& source, Kind kind)
+{
+	// anything that changes the output goes into the key next to the source bytes
+	uint64_t settings = ((uint64_t)VERSION << 8) | ((uint64_t)kind << 2) | ((uint64_t)compression << 1) | (uint64_t)(s3tcSupported == 1);
+	return hash(source.data(), source.size(), hash((const unsigned char*)&settings, sizeof(settings), 14695981039346656037ull));
+}
+
+uint64_t TextureCache::hash(const unsigned char* data, size_t size, uint64_t seed)
+{
+	// FNV-1a
+	uint64_t result = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		result ^= data[i];
+		result *= 1099511628211ull;
+	}
+	return result;
+}
+
+bool TextureCache::encode(const std::vector<unsigned char>& source, Kind kind, uint64_t key, std::vector<unsigned char>& output)
+{
+	int width, height, numChannels;
+	unsigned char* data = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &numChannels, 4);
+	if (!data) { return false; }
+
+	BlockCompressor::Format format = chooseFormat(kind, data, (size_t)width * height);
+
+	FileHeader header;
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.key = key;
+	header.format = (uint32_t)format;
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.levelCount = 1;
+	for (int size = std::max(width, height); size > 1; size /= 2) { header.levelCount++; }
+
+	output.assign((const unsigned char*)&header, (const unsigned char*)&header + sizeof(header));
+
+	std::vector<unsigned char> level(data, data + (size_t)width * height * 4);
+	std::vector<unsigned char> nextLevel;
+	stbi_image_free(data);
+
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		std::vector<unsigned char> encoded = BlockCompressor::Compress(format, level.data(), width, height);
+		output.insert(output.end(), encoded.begin(), encoded.end());
+
+		if (i + 1 == header.levelCount) { break; }
+
+		int nextWidth = std::max(width / 2, 1), nextHeight = std::max(height / 2, 1);
+		nextLevel.resize((size_t)nextWidth * nextHeight * 4);
+		downsample(level.data(), width, height, nextLevel.data(), kind == NORMAL);
+		level.swap(nextLevel);
+		width = nextWidth;
+		height = nextHeight;
+	}
+
+	return true;
+}
+
+BlockCompressor::Format TextureCache::chooseFormat(Kind kind, const unsigned char* rgba, size_t texelCount)
+{
+	if (!compression) { return BlockCompressor::RGBA8; }
+
+	// RGTC is core, only the color formats depend on the extension
+	if (kind == MASK) { return BlockCompressor::BC4; }
+	if (kind == NORMAL) { return BlockCompressor::BC5; }
+	if (s3tcSupported != 1) { return BlockCompressor::RGBA8; }
+
+	for (size_t i = 0; i < texelCount; i++)
+	{
+		if (rgba[i * 4 + 3] != 255) { return BlockCompressor::BC3; }
+	}
+	return BlockCompressor::BC1;
+}
+
+void TextureCache::downsample(const unsigned char* source, int width, int height, unsigned char* destination, bool normals)
+{
+	int destinationWidth = std::max(width / 2, 1), destinationHeight = std::max(height / 2, 1);
+
+	for (int y = 0; y < destinationHeight; y++)
+	{
+		// odd sizes and 1 texel wide levels reuse the last row or column
+		int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+		for (int x = 0; x < destinationWidth; x++)
+		{
+			int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+			const unsigned char* texels[4] = {
+				source + ((size_t)y0 * width + x0) * 4, source + ((size_t)y0 * width + x1) * 4,
+				source + ((size_t)y1 * width + x0) * 4, source + ((size_t)y1 * width + x1) * 4 };
+			unsigned char* pixel = destination + ((size_t)y * destinationWidth + x) * 4;
+
+			for (int c = 0; c < 4; c++)
+			{
+				pixel[c] = (unsigned char)((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+			}
+
+			if (normals)
+			{
+				float normal[3];
+				for (int c = 0; c < 3; c++) { normal[c] = pixel[c] / 127.5f - 1.0f; }
+				float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				if (length < 1e-4f) { continue; }
+				for (int c = 0; c < 3; c++) { pixel[c] = (unsigned char)((normal[c] / length + 1.0f) * 127.5f + 0.5f); }
+			}
+		}
+	}
+}
+
+bool TextureCache::parse(std::vector<unsigned char>& file, uint64_t key, Image& image)
+{
+	if (file.size() < sizeof(FileHeader)) { return false; }
+
+	FileHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (header.magic != MAGIC || header.version != VERSION || header.key != key || header.format > BlockCompressor::BC5 ||
+		header.width == 0 || header.height == 0 || header.levelCount == 0 || header.levelCount > 32)
+	{
+		return false;
+	}
+
+	image.format = (BlockCompressor::Format)header.format;
+	image.width = (int)header.width;
+	image.height = (int)header.height;
+	image.levelCount = (int)header.levelCount;
+	if (file.size() != image.LevelOffset(image.levelCount)) { return false; }
+
+	image.file.swap(file);
+	return true;
+}
+
+GLenum TextureCache::internalFormat(BlockCompressor::Format format)
+{
+	switch (format)
+	{
+		case BlockCompressor::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BlockCompressor::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BlockCompressor::BC4: return GL_COMPRESSED_RED_RGTC1;
+		case BlockCompressor::BC5: return GL_COMPRESSED_RG_RGTC2;
+		default: return GL_RGBA8;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "BlockCompressor.hpp"
+
+// Loads 2D textures through a cache of GPU ready files in CACHE_DIRECTORY. A cache file holds the full mip chain,
+// already block compressed, so a hit is one read and one glCompressedTexImage2D per level without decoding the
+// image or generating mipmaps. Files are named after a hash of the source file's bytes together with everything
+// that changes the encoding, an edited image or a new encoder version simply misses and writes a new file.
+// Stale files are never deleted, removing the directory is always safe.
+class TextureCache
+{
+public:
+	// what the texture holds decides its format: COLOR is BC1, or BC3 when any texel isn't opaque, MASK keeps only
+	// red as BC4 and NORMAL only x and y as BC5, shaders rebuild z from them
+	enum Kind { COLOR, MASK, NORMAL };
+
+	// contents of one cache file
+	struct Image
+	{
+		BlockCompressor::Format format = BlockCompressor::RGBA8;
+		int width = 0;
+		int height = 0;
+		int levelCount = 0;
+		// the whole file, header included, so it can be staged as it was read
+		std::vector<unsigned char> file;
+
+		int LevelWidth(int level) const { return width >> level > 1 ? width >> level : 1; }
+		int LevelHeight(int level) const { return height >> level > 1 ? height >> level : 1; }
+		// bytes from the start of the file
+		size_t LevelOffset(int level) const;
+	};
+
+	// asks the context which formats it samples, Prepare uses the answer. Call on the context's thread before
+	// handing work to other threads, Load calls it itself
+	static void Init();
+	// reads the cache file, or decodes and encodes the image and writes it. No GL calls, so any thread can run it
+	static bool Prepare(const char* path, Kind kind, Image& image);
+	// the key of path's cache file, equal keys give equal textures. No GL calls either
+	static bool ContentKey(const char* path, Kind kind, uint64_t& key, size_t& fileSize);
+	// specifies every level of texture. file points at Image::file, or is nullptr while a pixel unpack buffer
+	// holding the file is bound
+	static void Upload(const Image& image, GLuint texture, const unsigned char* file);
+
+	// Prepare and Upload in one go, returns 0 when the image can't be loaded
+	static GLuint Load(const char* path, Kind kind);
+
+	// without compression (or without S3TC for COLOR) textures are cached as RGBA8 with mipmaps
+	static void SetCompression(bool enabled) { TextureCache::compression = enabled; }
+	// hits and encodes, time spent preparing and the texture memory next to what RGBA8 would have taken
+	static void Report(std::ostream& out);
+
+private:
+	static const char* const CACHE_DIRECTORY;
+	static const uint32_t MAGIC;
+	// bump whenever the encoder or the file layout changes
+	static const uint32_t VERSION;
+
+	// followed by levelCount levels, largest first, each LevelSize bytes
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+	};
+
+	static bool readFile(const std::string& path, std::vector<unsigned char>& output);
+	static uint64_t contentKey(const std::vector<unsigned char>& source, Kind kind);
+	static uint64_t hash(const unsigned char* data, size_t size, uint64_t seed);
+
+	// decodes the source image and builds the contents of its cache file
+	static bool encode(const std::vector<unsigned char>& source, Kind kind, uint64_t key, std::vector<unsigned char>& output);
+	static BlockCompressor::Format chooseFormat(Kind kind, const unsigned char* rgba, size_t texelCount);
+	// 2x2 box filter, normals are renormalized after averaging
+	static void downsample(const unsigned char* source, int width, int height, unsigned char* destination, bool normals);
+	// takes over file when it matches the key and isn't cut short
+	static bool parse(std::vector<unsigned char>& file, uint64_t key, Image& image);
+	static GLenum internalFormat(BlockCompressor::Format format);
+
+	static bool compression;
+	// -1 until Init asks the context
+	static int s3tcSupported;
+	// Prepare runs on the streaming threads, everything below is counted under this lock
+	static std::mutex statisticsMutex;
+	static size_t textureCount;
+	static size_t cacheHits;
+	static size_t encodedCount;
+	static size_t gpuBytes;
+	static size_t uncompressedBytes;
+	static double totalMilliseconds;
+};
@@ -0,0 +1,192 @@
+#include "TextureRegistry.hpp"
+#include "../core/File.hpp"
+#include "GLState.hpp"
+#include "TextureStreamer.hpp"
+#include <algorithm>
+#include <cctype>
+
+std::unordered_map<GLuint, TextureRegistry::Entry> TextureRegistry::entries;
+std::unordered_map<std::string, GLuint> TextureRegistry::byPath;
+std::unordered_map<size_t, std::vector<GLuint>> TextureRegistry::bySize;
+
+size_t TextureRegistry::sharedAcquires = 0;
+size_t TextureRegistry::savedFileBytes = 0;
+size_t TextureRegistry::deletedTextures = 0;
+
+GLuint TextureRegistry::Acquire(const char* path, TextureCache::Kind kind, const void* owner)
+{
+	std::string key = canonicalKey(path, kind);
+
+	std::unordered_map<std::string, GLuint>::iterator known = byPath.find(key);
+	if (known != byPath.end())
+	{
+		Entry& entry = entries[known->second];
+		entry.references++;
+		// the same owner asking again, several meshes of one model for instance, would not have loaded it twice
+		if (owner == nullptr || std::find(entry.owners.begin(), entry.owners.end(), owner) == entry.owners.end())
+		{
+			entry.owners.push_back(owner);
+			entry.shared++;
+			sharedAcquires++;
+			savedFileBytes += entry.fileSize;
+		}
+		return known->second;
+	}
+
+	// another path to the same bytes, a copied texture next to each model for instance. Only a file the size of
+	// a loaded one can be, the common case stays a stat and leaves reading the file to the decode threads
+	uint64_t contentKey = 0;
+	size_t fileSize = 0;
+	bool hasContentKey = false;
+	std::unordered_map<size_t, std::vector<GLuint>>::iterator sameSize = bySize.end();
+	if (File::Size(path, fileSize)) { sameSize = bySize.find(fileSize); }
+	if (sameSize != bySize.end())
+	{
+		TextureCache::Init();
+		hasContentKey = TextureCache::ContentKey(path, kind, contentKey, fileSize);
+		for (GLuint candidate : sameSize->second)
+		{
+			Entry& entry = entries[candidate];
+			if (!hasContentKey || entry.kind != kind) { continue; }
+			if (!entry.hasContentKey)
+			{
+				size_t candidateSize = 0;
+				entry.hasContentKey = TextureCache::ContentKey(entry.source.c_str(), entry.kind, entry.contentKey, candidateSize);
+			}
+			if (!entry.hasContentKey || entry.contentKey != contentKey) { continue; }
+
+			entry.references++;
+			entry.shared++;
+			entry.owners.push_back(owner);
+			entry.paths.push_back(key);
+			byPath[key] = candidate;
+			sharedAcquires++;
+			savedFileBytes += entry.fileSize;
+			return candidate;
+		}
+	}
+
+	GLuint texture = TextureStreamer::Request(path, kind);
+	if (texture == 0) { return 0; }
+
+	Entry entry;
+	entry.references = 1;
+	entry.paths.push_back(key);
+	entry.source = path;
+	entry.owners.push_back(owner);
+	entry.kind = kind;
+	entry.hasContentKey = hasContentKey;
+	entry.contentKey = contentKey;
+	entry.fileSize = fileSize;
+	entry.shared = 0;
+	entries[texture] = entry;
+
+	byPath[key] = texture;
+	if (fileSize != 0) { bySize[fileSize].push_back(texture); }
+	return texture;
+}
+
+void TextureRegistry::Release(GLuint texture)
+{
+	std::unordered_map<GLuint, Entry>::iterator found = entries.find(texture);
+	if (found == entries.end()) { return; }
+
+	Entry& entry = found->second;
+	if (--entry.references > 0) { return; }
+
+	for (const std::string& path : entry.paths)
+	{
+		byPath.erase(path);
+	}
+	if (entry.fileSize != 0)
+	{
+		std::vector<GLuint>& sameSize = bySize[entry.fileSize];
+		sameSize.erase(std::find(sameSize.begin(), sameSize.end(), texture));
+		if (sameSize.empty()) { bySize.erase(entry.fileSize); }
+	}
+	entries.erase(found);
+
+	TextureStreamer::Cancel(texture);
+	glDeleteTextures(1, &texture);
+	GLState::ForgetTexture(texture);
+	deletedTextures++;
+}
+
+void TextureRegistry::Report(std::ostream& out)
+{
+	size_t savedGpuBytes = 0;
+	for (const std::pair<const GLuint, Entry>& entry : entries)
+	{
+		if (entry.second.shared != 0) { savedGpuBytes += entry.second.shared * textureBytes(entry.first); }
+	}
+
+	out << "Texture registry: " << entries.size() << " textures, " << sharedAcquires << " shared acquires saved "
+		<< savedFileBytes / 1024 << " KiB of files and " << savedGpuBytes / 1024 << " KiB on the GPU, "
+		<< deletedTextures << " deleted" << std::endl;
+}
+
+std::string TextureRegistry::canonicalKey(const char* path, TextureCache::Kind kind)
+{
+	std::string normalized(path);
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+#ifdef _WIN32
+	std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+#endif
+
+	std::vector<std::string> segments;
+	size_t start = 0;
+	while (start <= normalized.size())
+	{
+		size_t end = std::min(normalized.find('/', start), normalized.size());
+		std::string segment = normalized.substr(start, end - start);
+		start = end + 1;
+
+		if (segment.empty() || segment == ".") { continue; }
+		if (segment == ".." && !segments.empty() && segments.back() != "..")
+		{
+			segments.pop_back();
+			continue;
+		}
+		segments.push_back(segment);
+	}
+
+	std::string key = !normalized.empty() && normalized[0] == '/' ? "/" : "";
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		if (i != 0) { key += '/'; }
+		key += segments[i];
+	}
+	return key + '#' + (char)('0' + kind);
+}
+
+size_t TextureRegistry::textureBytes(GLuint texture)
+{
+	size_t bytes = 0;
+	GLState::BindTexture(GL_TEXTURE_2D, texture);
+
+	GLint maxLevel = 0;
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+	for (GLint level = 0; level <= maxLevel; level++)
+	{
+		GLint width = 0, height = 0, compressed = GL_FALSE;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+		if (width == 0 || height == 0) { break; }
+
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+		if (compressed == GL_TRUE)
+		{
+			GLint size = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+			bytes += (size_t)size;
+		}
+		else
+		{
+			// every uncompressed texture is RGBA8
+			bytes += (size_t)width * height * 4;
+		}
+	}
+
+	GLState::BindTexture(GL_TEXTURE_2D, 0);
+	return bytes;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "TextureCache.hpp"
+
+// Process wide owner of every file texture. Acquire looks a texture up by its canonical path, then by the
+// content key of the file, and only loads it (through TextureStreamer) when neither is known, so every image is
+// decoded and uploaded once however many models use it. Files are only hashed when their size matches a texture
+// that is already loaded, everything else is read by the decode threads alone. Each Acquire holds a reference that Release gives back,
+// the last Release deletes the texture.
+class TextureRegistry
+{
+public:
+	// needs a current context, returns 0 only when a synchronous load fails. owner only feeds the report: repeat
+	// acquires through the same path by the same owner are not counted as shared
+	static GLuint Acquire(const char* path, TextureCache::Kind kind, const void* owner = nullptr);
+	// textures the registry doesn't own, like 0, are ignored
+	static void Release(GLuint texture);
+
+	// textures alive, how many acquires by another owner or through another path were shared and the file and GPU
+	// bytes loading them separately would have cost
+	static void Report(std::ostream& out);
+
+private:
+	struct Entry
+	{
+		unsigned int references;
+		// keys of byPath pointing here, more than one when different paths have the same content
+		std::vector<std::string> paths;
+		// the file and kind it was requested with, hashed the first time another file of the same size shows up
+		std::string source;
+		TextureCache::Kind kind;
+		bool hasContentKey;
+		uint64_t contentKey;
+		size_t fileSize;
+		// owners that acquired it so far
+		std::vector<const void*> owners;
+		// acquires answered by this entry for a new owner or path
+		unsigned int shared;
+	};
+
+	// forward slashes, no "." or "dir/.." segments and lower case on Windows, plus the kind
+	static std::string canonicalKey(const char* path, TextureCache::Kind kind);
+	// current size of the texture's levels, a still streaming texture counts as its placeholder
+	static size_t textureBytes(GLuint texture);
+
+	static std::unordered_map<GLuint, Entry> entries;
+	static std::unordered_map<std::string, GLuint> byPath;
+	// live textures per file size, the candidates a new file is compared with
+	static std::unordered_map<size_t, std::vector<GLuint>> bySize;
+
+	static size_t sharedAcquires;
+	static size_t savedFileBytes;
+	static size_t deletedTextures;
+};
@@ -0,0 +1,325 @@
+#include "TextureStreamer.hpp"
+#include "../core/Profiler.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+bool TextureStreamer::running = false;
+size_t TextureStreamer::uploadBudget = TextureStreamer::DEFAULT_UPLOAD_BUDGET;
+
+std::vector<std::thread> TextureStreamer::threads;
+std::mutex TextureStreamer::mutex;
+std::condition_variable TextureStreamer::wake;
+std::deque<TextureStreamer::Job> TextureStreamer::queued;
+std::deque<TextureStreamer::Job> TextureStreamer::prepared;
+bool TextureStreamer::stopping = false;
+std::unordered_map<GLuint, uint64_t> TextureStreamer::decoding;
+std::unordered_set<uint64_t> TextureStreamer::cancelled;
+
+std::deque<TextureStreamer::Upload> TextureStreamer::staging;
+std::vector<TextureStreamer::Upload> TextureStreamer::fenced;
+
+size_t TextureStreamer::requestCount = 0;
+size_t TextureStreamer::residentCount = 0;
+size_t TextureStreamer::failedCount = 0;
+size_t TextureStreamer::cancelledCount = 0;
+size_t TextureStreamer::uploadedBytes = 0;
+unsigned int TextureStreamer::updateFrames = 0;
+unsigned int TextureStreamer::lastResidentFrame = 0;
+double TextureStreamer::uploadMilliseconds = 0.0;
+double TextureStreamer::maxUploadMilliseconds = 0.0;
+
+void TextureStreamer::Init(unsigned int threadCount)
+{
+	if (running) { return; }
+
+	// Prepare picks formats by what the context supports, ask before the threads need it
+	TextureCache::Init();
+
+	if (threadCount == 0)
+	{
+		threadCount = std::max(std::thread::hardware_concurrency() / 2, 1u);
+	}
+
+	stopping = false;
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		threads.emplace_back(&TextureStreamer::decodeLoop);
+	}
+	running = true;
+}
+
+void TextureStreamer::Shutdown()
+{
+	if (!running) { return; }
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queued.clear();
+	}
+	wake.notify_all();
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	threads.clear();
+	prepared.clear();
+	decoding.clear();
+	cancelled.clear();
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	for (Upload& upload : staging)
+	{
+		glDeleteBuffers(1, &upload.buffer);
+	}
+	for (Upload& upload : fenced)
+	{
+		glDeleteSync(upload.fence);
+		glDeleteBuffers(1, &upload.buffer);
+	}
+	staging.clear();
+	fenced.clear();
+	running = false;
+}
+
+GLuint TextureStreamer::Request(const char* path, TextureCache::Kind kind)
+{
+	if (!running) { return TextureCache::Load(path, kind); }
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	createPlaceholder(texture, kind);
+	requestCount++;
+
+	Job job;
+	job.path = path;
+	job.kind = kind;
+	job.texture = texture;
+	job.request = requestCount;
+	job.prepared = false;
+	decoding[texture] = job.request;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.push_back(std::move(job));
+	}
+	wake.notify_one();
+
+	return texture;
+}
+
+void TextureStreamer::Cancel(GLuint texture)
+{
+	if (!running) { return; }
+
+	for (size_t i = 0; i < staging.size(); i++)
+	{
+		if (staging[i].job.texture != texture) { continue; }
+
+		glDeleteBuffers(1, &staging[i].buffer);
+		staging.erase(staging.begin() + i);
+		cancelledCount++;
+		return;
+	}
+
+	for (size_t i = 0; i < fenced.size(); i++)
+	{
+		if (fenced[i].job.texture != texture) { continue; }
+
+		// already specified, only the buffer is left
+		glDeleteSync(fenced[i].fence);
+		glDeleteBuffers(1, &fenced[i].buffer);
+		fenced[i] = std::move(fenced.back());
+		fenced.pop_back();
+		cancelledCount++;
+		return;
+	}
+
+	// resident and failed textures aren't tracked
+	std::unordered_map<GLuint, uint64_t>::iterator found = decoding.find(texture);
+	if (found == decoding.end()) { return; }
+	uint64_t request = found->second;
+	decoding.erase(found);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < queued.size(); i++)
+		{
+			if (queued[i].request != request) { continue; }
+
+			queued.erase(queued.begin() + i);
+			cancelledCount++;
+			return;
+		}
+	}
+
+	// a decode thread has it or it waits in prepared, Update drops it even when the name is handed out again
+	cancelled.insert(request);
+}
+
+void TextureStreamer::Update()
+{
+	if (!running) { return; }
+
+	static const int uploadPhase = Profiler::RegisterPhase("texture upload");
+	static const int uploadBytesPhase = Profiler::RegisterPhase("texture upload KiB", Profiler::Unit::Count);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	ProfileScope scope(uploadPhase);
+
+	retire();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (!prepared.empty())
+		{
+			Job& job = prepared.front();
+			if (cancelled.erase(job.request) != 0)
+			{
+				cancelledCount++;
+				prepared.pop_front();
+				continue;
+			}
+
+			decoding.erase(job.texture);
+			if (job.prepared)
+			{
+				Upload upload;
+				upload.job = std::move(job);
+				upload.buffer = 0;
+				upload.staged = 0;
+				upload.fence = 0;
+				staging.push_back(std::move(upload));
+			}
+			else
+			{
+				// TextureCache already reported why, the placeholder stays
+				failedCount++;
+			}
+			prepared.pop_front();
+		}
+	}
+
+	size_t budget = uploadBudget;
+	stage(budget);
+	Profiler::AddCount(uploadBytesPhase, (double)(uploadBudget - budget) / 1024.0);
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	uploadMilliseconds += milliseconds;
+	maxUploadMilliseconds = std::max(maxUploadMilliseconds, milliseconds);
+	updateFrames++;
+}
+
+void TextureStreamer::Report(std::ostream& out)
+{
+	out << "Texture streamer: " << residentCount << "/" << requestCount << " textures resident";
+	if (failedCount != 0) { out << ", " << failedCount << " failed"; }
+	out << ", last one after " << lastResidentFrame << " frames, " << uploadedBytes / 1024 << " KiB uploaded, "
+		<< uploadMilliseconds << " ms on the main thread (" << maxUploadMilliseconds << " ms worst frame), budget "
+		<< uploadBudget / 1024 << " KiB/frame" << (running ? "" : " (synchronous)") << std::endl;
+}
+
+void TextureStreamer::decodeLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [] { return stopping || !queued.empty(); });
+		if (stopping) { return; }
+
+		Job job = std::move(queued.front());
+		queued.pop_front();
+
+		lock.unlock();
+		job.prepared = TextureCache::Prepare(job.path.c_str(), job.kind, job.image);
+		lock.lock();
+
+		prepared.push_back(std::move(job));
+	}
+}
+
+void TextureStreamer::stage(size_t& budget)
+{
+	while (!staging.empty() && budget > 0)
+	{
+		Upload& upload = staging.front();
+		const std::vector<unsigned char>& file = upload.job.image.file;
+
+		if (upload.buffer == 0)
+		{
+			glGenBuffers(1, &upload.buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)file.size(), nullptr, GL_STREAM_DRAW);
+		}
+		else
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+		}
+
+		size_t chunk = std::min(file.size() - upload.staged, budget);
+		// the GPU hasn't seen this buffer yet, nothing to synchronize with
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, (GLintptr)upload.staged, (GLsizeiptr)chunk,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (mapped != nullptr)
+		{
+			std::memcpy(mapped, file.data() + upload.staged, chunk);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		else
+		{
+			glBufferSubData(GL_PIXEL_UNPACK_BUFFER, (GLintptr)upload.staged, (GLsizeiptr)chunk, file.data() + upload.staged);
+		}
+
+		upload.staged += chunk;
+		budget -= chunk;
+		uploadedBytes += chunk;
+
+		if (upload.staged < file.size()) { break; }
+
+		// every level at once, the texture goes from placeholder to complete between two draws
+		TextureCache::Upload(upload.job.image, upload.job.texture, nullptr);
+		upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		upload.job.image.file = std::vector<unsigned char>();
+		fenced.push_back(std::move(upload));
+		staging.pop_front();
+	}
+
+	// the synchronous loaders expect client memory pointers
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureStreamer::retire()
+{
+	for (size_t i = 0; i < fenced.size();)
+	{
+		GLenum status = glClientWaitSync(fenced[i].fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		{
+			i++;
+			continue;
+		}
+
+		glDeleteSync(fenced[i].fence);
+		glDeleteBuffers(1, &fenced[i].buffer);
+		residentCount++;
+		lastResidentFrame = updateFrames;
+
+		fenced[i] = std::move(fenced.back());
+		fenced.pop_back();
+	}
+}
+
+void TextureStreamer::createPlaceholder(GLuint texture, TextureCache::Kind kind)
+{
+	// neutral for what the texture holds, in Kind order: mid grey color, full masks, a flat normal
+	static const unsigned char texels[3][4] = { { 128, 128, 128, 255 }, { 255, 255, 255, 255 }, { 128, 128, 255, 255 } };
+
+	GLState::BindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels[kind]);
+	GLState::BindTexture(GL_TEXTURE_2D, 0);
+}
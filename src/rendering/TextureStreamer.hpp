@@ -0,0 +1,98 @@
+#pragma once
+#include <glad/glad.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "TextureCache.hpp"
+
+// Loads textures without stalling the main thread. Request returns the texture name right away, holding a 1x1
+// placeholder, and queues the file for the decode threads, which run TextureCache::Prepare. Update copies prepared
+// files into pixel unpack buffers, no more than the upload budget per frame, and respecifies the texture from the
+// buffer once all of it is staged, so the placeholder is swapped for the full mip chain in one go. A fence tells
+// when the GPU has read the buffer and it can be deleted. The ThreadPool only runs blocking batches, so the decode
+// threads are the streamer's own. Without Init every Request loads synchronously through TextureCache::Load.
+class TextureStreamer
+{
+public:
+	static const size_t DEFAULT_UPLOAD_BUDGET = 4 * 1024 * 1024;
+
+	// needs a current context. 0 threads uses half the hardware threads
+	static void Init(unsigned int threadCount = 0);
+	// stops the decode threads and drops unfinished work, textures that never arrived keep their placeholder
+	static void Shutdown();
+
+	// a new texture for every call, TextureRegistry shares them between users
+	static GLuint Request(const char* path, TextureCache::Kind kind);
+	// forgets a texture that is about to be deleted, whatever stage it is in
+	static void Cancel(GLuint texture);
+	// once per frame on the context's thread
+	static void Update();
+
+	// bytes copied into unpack buffers per frame, a texture larger than that takes several frames
+	static void SetUploadBudget(size_t bytes) { TextureStreamer::uploadBudget = bytes > 0 ? bytes : 1; }
+	// requested textures that aren't resident yet
+	static size_t Pending() { return requestCount - residentCount - failedCount - cancelledCount; }
+	// textures streamed, how many frames they took and the main thread time spent uploading them
+	static void Report(std::ostream& out);
+
+private:
+	struct Job
+	{
+		std::string path;
+		TextureCache::Kind kind;
+		GLuint texture;
+		// GL reuses the names of deleted textures, cancellation goes by this id instead
+		uint64_t request;
+		TextureCache::Image image;
+		bool prepared;
+	};
+
+	struct Upload
+	{
+		Job job;
+		GLuint buffer;
+		size_t staged;
+		GLsync fence;
+	};
+
+	static void decodeLoop();
+	static void stage(size_t& budget);
+	static void retire();
+	static void createPlaceholder(GLuint texture, TextureCache::Kind kind);
+
+	static bool running;
+	static size_t uploadBudget;
+
+	// shared with the decode threads
+	static std::vector<std::thread> threads;
+	static std::mutex mutex;
+	static std::condition_variable wake;
+	static std::deque<Job> queued;
+	static std::deque<Job> prepared;
+	static bool stopping;
+
+	// main thread only. Request of every texture that is queued, being prepared or prepared, until Update takes it back
+	static std::unordered_map<GLuint, uint64_t> decoding;
+	// requests cancelled after a decode thread took them, dropped when they come back
+	static std::unordered_set<uint64_t> cancelled;
+	// staging in request order and waiting for their fences
+	static std::deque<Upload> staging;
+	static std::vector<Upload> fenced;
+
+	static size_t requestCount;
+	static size_t residentCount;
+	static size_t failedCount;
+	static size_t cancelledCount;
+	static size_t uploadedBytes;
+	static unsigned int updateFrames;
+	static unsigned int lastResidentFrame;
+	static double uploadMilliseconds;
+	static double maxUploadMilliseconds;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Typed handle to a uniform of a linked program, resolved once through Material::GetUniform so nothing on the
+// draw path looks uniforms up by name. A handle to a uniform the program doesn't have is -1, which GL ignores.
+// Set expects the owning program to be current.
+template <typename T>
+struct Uniform
+{
+	GLint location = -1;
+
+	void Set(const T& value) const;
+	bool IsValid() const { return location >= 0; }
+};
+
+template <> inline void Uniform<glm::mat4>::Set(const glm::mat4& value) const { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+template <> inline void Uniform<glm::vec4>::Set(const glm::vec4& value) const { glUniform4fv(location, 1, glm::value_ptr(value)); }
+template <> inline void Uniform<glm::vec3>::Set(const glm::vec3& value) const { glUniform3fv(location, 1, glm::value_ptr(value)); }
+template <> inline void Uniform<glm::vec2>::Set(const glm::vec2& value) const { glUniform2fv(location, 1, glm::value_ptr(value)); }
+template <> inline void Uniform<float>::Set(const float& value) const { glUniform1f(location, value); }
+template <> inline void Uniform<int>::Set(const int& value) const { glUniform1i(location, value); }
+
+// whether a uniform of the given GL type can be set through a Uniform<T>
+template <typename T> inline bool UniformTypeMatches(GLenum type);
+template <> inline bool UniformTypeMatches<glm::mat4>(GLenum type) { return type == GL_FLOAT_MAT4; }
+template <> inline bool UniformTypeMatches<glm::vec4>(GLenum type) { return type == GL_FLOAT_VEC4; }
+template <> inline bool UniformTypeMatches<glm::vec3>(GLenum type) { return type == GL_FLOAT_VEC3; }
+template <> inline bool UniformTypeMatches<glm::vec2>(GLenum type) { return type == GL_FLOAT_VEC2; }
+template <> inline bool UniformTypeMatches<float>(GLenum type) { return type == GL_FLOAT; }
+template <> inline bool UniformTypeMatches<int>(GLenum type)
+{
+	return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_2D_ARRAY || type == GL_SAMPLER_CUBE;
+}
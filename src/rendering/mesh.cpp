@@ -1,98 +1,180 @@
 #include "mesh.hpp"
+#include "GLState.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
 
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+Mesh::Mesh(const MeshGeometry& geometry, vector<Texture> textures, vector<TextureBinding> textureSlots, PositionQuantization quantization, AABB bounds, BoundingSphere sphere)
 {
-    this->vertices = vertices;
-    this->indices = indices;
     this->textures = textures;
+    this->textureSlots = textureSlots;
+    this->textureSet = textureSetID(textureSlots);
+    this->quantization = quantization;
+    this->dequantize = quantization.Matrix();
+    this->bounds = bounds;
+    this->sphere = sphere;
 
-    // now that we have all the required data, set the vertex buffers and its attribute pointers.
-    setupMesh();
+    upload(geometry);
 }
 
-void Mesh::Draw(unsigned int program)
+void Mesh::BindTextures() const
 {
-    // bind appropriate textures
-    unsigned int diffuseNr = 1;
-    unsigned int specularNr = 1;
-    unsigned int normalNr = 1;
-    unsigned int heightNr = 1;
-    unsigned int roughnessNr = 1;
-    unsigned int ambientOcclusionNr = 1;
-    for (unsigned int i = 0; i < textures.size(); i++)
+    // the samplers already point at the slot units, the state cache skips units that already hold the texture
+    for (unsigned int i = 0; i < textureSlots.size(); i++)
+        GLState::BindTextureUnit(textureSlots[i].unit, GL_TEXTURE_2D, textureSlots[i].id);
+}
+
+unsigned int Mesh::textureSetID(const vector<TextureBinding>& slots)
+{
+    static std::map<vector<unsigned int>, unsigned int> textureSets;
+
+    vector<unsigned int> key;
+    for (unsigned int i = 0; i < slots.size(); i++)
+    {
+        key.push_back(slots[i].unit);
+        key.push_back(slots[i].id);
+    }
+
+    auto found = textureSets.find(key);
+    if (found != textureSets.end())
+        return found->second;
+
+    unsigned int id = static_cast<unsigned int>(textureSets.size());
+    textureSets[key] = id;
+    return id;
+}
+
+MeshGeometry Mesh::BuildGeometry(const vector<Vertex>& vertices, const vector<unsigned int>& indices, const PositionQuantization& quantization, vector<PackedVertex>& packed, vector<unsigned char>& indexData)
+{
+    MeshGeometry geometry;
+
+    packed.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+        packed[i] = packVertex(vertices[i], quantization);
+
+    vector<unsigned int> lodIndices = buildLods(vertices, indices, geometry.lods);
+
+    if (vertices.size() <= 65536)
+    {
+        geometry.indexType = GL_UNSIGNED_SHORT;
+        indexData.resize(lodIndices.size() * sizeof(unsigned short));
+        unsigned short* shortIndices = reinterpret_cast<unsigned short*>(indexData.data());
+        for (size_t i = 0; i < lodIndices.size(); i++)
+            shortIndices[i] = (unsigned short)lodIndices[i];
+    }
+    else
     {
-        glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-        // retrieve texture number (the N in diffuse_textureN)
-        string number;
-        string name = textures[i].type;
-        if (name == "texture_diffuse")
-            number = std::to_string(diffuseNr++);
-        else if (name == "texture_specular")
-            number = std::to_string(specularNr++); // transfer unsigned int to string
-        else if (name == "texture_normal")
-            number = std::to_string(normalNr++); // transfer unsigned int to string
-        else if (name == "texture_height")
-            number = std::to_string(heightNr++); // transfer unsigned int to string
-        else if (name == "texture_roughness")
-            number = std::to_string(roughnessNr++); // transfer unsigned int to string
-        else if (name == "texture_ao")
-            number = std::to_string(ambientOcclusionNr++); // transfer unsigned int to string
-
-        // now set the sampler to the correct texture unit
-        glUniform1i(glGetUniformLocation(program, (name + number).c_str()), i);
-        // and finally bind the texture
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        geometry.indexType = GL_UNSIGNED_INT;
+        indexData.resize(lodIndices.size() * sizeof(unsigned int));
+        std::memcpy(indexData.data(), lodIndices.data(), indexData.size());
     }
 
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    geometry.vertices = packed.data();
+    geometry.vertexCount = packed.size();
+    geometry.indices = indexData.data();
+    geometry.indexCount = lodIndices.size();
+    return geometry;
+}
+
+void Mesh::upload(const MeshGeometry& source)
+{
+    arena = &GeometryArena::ForLayout(sizeof(PackedVertex), &Mesh::vertexLayout, source.indexType);
+    geometry = arena->Allocate(source.vertices, source.vertexCount, source.indices, source.indexCount);
+    VAO = arena->VAO();
+
+    lods = source.lods;
+    for (unsigned int i = 0; i < lods.size(); i++)
+        lods[i].firstIndex += geometry.firstIndex;
+}
+
+vector<unsigned int> Mesh::buildLods(const vector<Vertex>& vertices, const vector<unsigned int>& indices, vector<MeshLod>& lods)
+{
+    // the index lists of all levels one after the other, lods gets their offsets relative to the allocation
+    vector<unsigned int> lodIndices = indices;
+    MeshLod full = { 0, (GLsizei)indices.size(), 0.0f };
+    lods.assign(1, full);
+
+    vector<unsigned int> previous = indices;
+    while (lods.size() < MAX_LODS)
+    {
+        float error;
+        vector<unsigned int> simplified = MeshSimplifier::Simplify(vertices, previous, previous.size() / 2, &error);
+        // a level that barely removes anything isn't worth its memory, the simplifier has run out of collapses
+        if (simplified.empty() || simplified.size() > previous.size() * 3 / 4)
+            break;
+        // collapses scatter the imported order, the level gets its own cache and overdraw order
+        MeshOptimizer::OptimizeTriangles(vertices, simplified);
 
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
+        MeshLod lod = { (GLuint)lodIndices.size(), (GLsizei)simplified.size(), error };
+        lods.push_back(lod);
+        lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.end());
+        previous.swap(simplified);
+    }
+    return lodIndices;
 }
 
-void Mesh::setupMesh()
+PackedVertex Mesh::packVertex(const Vertex& vertex, const PositionQuantization& quantization)
 {
-    // create buffers/arrays
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-    // load data into vertex buffers
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // A great thing about structs is that their memory layout is sequential for all its items.
-    // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-    // again translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    PackedVertex packed;
+
+    glm::vec3 position = glm::clamp((vertex.Position - quantization.origin) / quantization.size, 0.0f, 1.0f);
+    packed.Position[0] = (unsigned short)(position.x * 65535.0f + 0.5f);
+    packed.Position[1] = (unsigned short)(position.y * 65535.0f + 0.5f);
+    packed.Position[2] = (unsigned short)(position.z * 65535.0f + 0.5f);
+    packed.Position[3] = 0;
+
+    // orthonormal frame around the normal, meshes without normals or uvs still get a valid one
+    glm::vec3 normal = glm::length(vertex.Normal) > 0.0f ? glm::normalize(vertex.Normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+    glm::vec3 tangent = vertex.Tangent - normal * glm::dot(normal, vertex.Tangent);
+    if (glm::length(tangent) < 1e-6f)
+        tangent = glm::cross(normal, glm::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+    tangent = glm::normalize(tangent);
+    glm::vec3 bitangent = glm::cross(normal, tangent);
+    bool flipped = glm::dot(bitangent, vertex.Bitangent) < 0.0f;
+
+    glm::quat frame = glm::quat_cast(glm::mat3(tangent, bitangent, normal));
+    glm::vec4 q = glm::normalize(glm::vec4(frame.x, frame.y, frame.z, frame.w));
+    if (q.w < 0.0f)
+        q = -q;
+
+    // keep w away from zero so its sign survives snorm16, then let the sign carry the bitangent direction
+    const float bias = 1.0f / 32767.0f;
+    if (q.w < bias)
+    {
+        float scale = std::sqrt(1.0f - bias * bias);
+        q = glm::vec4(q.x * scale, q.y * scale, q.z * scale, bias);
+    }
+    if (flipped)
+        q = -q;
+
+    for (int i = 0; i < 4; i++)
+        packed.QTangent[i] = (short)std::round(glm::clamp(q[i], -1.0f, 1.0f) * 32767.0f);
+
+    packed.TexCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+    packed.TexCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+
+    return packed;
+}
 
+void Mesh::vertexLayout()
+{
     // set the vertex attribute pointers
-    // vertex Positions
+    // quantized positions
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // vertex normals
+    glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+    // tangent frame quaternion
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    glVertexAttribPointer(1, 4, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, QTangent));
     // vertex texture coords
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-    // vertex tangent
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-    // vertex bitangent
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-    // ids
-    glEnableVertexAttribArray(5);
-    glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-    // weights
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-    glBindVertexArray(0);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+}
+
+glm::mat4 PositionQuantization::Matrix() const
+{
+    return glm::scale(glm::translate(glm::mat4(1.0f), origin), glm::vec3(size));
 }
@@ -6,12 +6,13 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "GeometryArena.hpp"
+#include "Bounds.hpp"
+
 #include <string>
 #include <vector>
 using namespace std;
 
-constexpr auto MAX_BONE_INFLUENCE = 4;
-
 struct Vertex {
     // position
     glm::vec3 Position;
@@ -23,10 +24,25 @@ struct Vertex {
     glm::vec3 Tangent;
     // bitangent
     glm::vec3 Bitangent;
-    //bone indexes which will influence this vertex
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    //weights from each bone
-    float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+// what the GPU gets for a Vertex, 20 bytes instead of 56
+struct PackedVertex {
+    // unorm16 inside the model's quantization cube, w is padding
+    unsigned short Position[4];
+    // snorm16 quaternion of the tangent frame, a negative w flips the bitangent
+    short QTangent[4];
+    // half floats, uvs are allowed to tile outside 0..1
+    unsigned short TexCoords[2];
+};
+
+// cube that PackedVertex positions are quantized into, shared by all meshes of a model. The scale is uniform so
+// folding Matrix() into the instance transform leaves the normal matrix intact
+struct PositionQuantization {
+    glm::vec3 origin = glm::vec3(0.0f);
+    float size = 1.0f;
+
+    glm::mat4 Matrix() const;
 };
 
 struct Texture {
@@ -35,25 +51,82 @@ struct Texture {
     string path;
 };
 
+// fixed texture unit per texture type, Material points the matching texture_<type>1 sampler of every program at it
+enum TextureSlot {
+    SLOT_DIFFUSE = 0,
+    SLOT_SPECULAR,
+    SLOT_NORMAL,
+    SLOT_ROUGHNESS,
+    SLOT_AO,
+    SLOT_HEIGHT,
+    SLOT_COUNT
+};
+
+// a texture and the unit it is bound to, resolved once when the model is loaded
+struct TextureBinding {
+    unsigned int unit;
+    unsigned int id;
+};
+
+// index range of one level of detail inside the mesh's arena allocation, all levels share the vertices
+struct MeshLod {
+    GLuint firstIndex;
+    GLsizei indexCount;
+    // largest simplification error, in model units
+    float error;
+};
+
+// what a mesh uploads: packed vertices and the index lists of every level, in the index type of the arena they go
+// to. Only points at the data, which belongs to whoever built or mapped it
+struct MeshGeometry {
+    const PackedVertex* vertices = nullptr;
+    size_t vertexCount = 0;
+    const void* indices = nullptr;
+    size_t indexCount = 0;
+    // GL_UNSIGNED_SHORT when the vertices fit, GL_UNSIGNED_INT otherwise
+    GLenum indexType = GL_UNSIGNED_INT;
+    // index ranges relative to the start of indices
+    vector<MeshLod> lods;
+};
+
 class Mesh {
 public:
-    // mesh Data
-    vector<Vertex>       vertices;
-    vector<unsigned int> indices;
+    static const unsigned int MAX_LODS = 4;
+
+    // mesh Data, the vertices and indices only live in the arena
     vector<Texture>      textures;
+    vector<TextureBinding> textureSlots;
+    // compact id shared by all meshes with identical textureSlots, used to sort draws by texture set
+    unsigned int textureSet;
+    // turns the quantized positions back into model space, RenderObject folds it into the instance transform
+    PositionQuantization quantization;
+    glm::mat4 dequantize;
+    // model space bounds of the unquantized positions, the culler tests the sphere and keeps the box for queries
+    AABB bounds;
+    BoundingSphere sphere;
+    // the mesh lives in the shared arena of its vertex layout, VAO is the arena's
+    GeometryArena* arena;
+    GeometryArena::Allocation geometry;
+    // lods[0] is the full mesh, every further level has about half the triangles of the one before
+    vector<MeshLod> lods;
     unsigned int VAO;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
+    // uploads geometry built earlier, Model builds it once and the mesh cache maps it from disk afterwards
+    Mesh(const MeshGeometry& geometry, vector<Texture> textures, vector<TextureBinding> textureSlots, PositionQuantization quantization, AABB bounds, BoundingSphere sphere);
+
+    // packs the vertices and simplifies the levels of detail, the result points into packed and indexData
+    static MeshGeometry BuildGeometry(const vector<Vertex>& vertices, const vector<unsigned int>& indices, const PositionQuantization& quantization, vector<PackedVertex>& packed, vector<unsigned char>& indexData);
 
-    // render the mesh
-    void Draw(unsigned int program);
+    // RenderQueue draws the mesh from its arena, this binds the textures for it
+    void BindTextures() const;
 
 private:
-    // render data 
-    unsigned int VBO, EBO;
+    // uploads the mesh and its simplified levels into the arena for its layout and index type
+    void upload(const MeshGeometry& source);
+    static vector<unsigned int> buildLods(const vector<Vertex>& vertices, const vector<unsigned int>& indices, vector<MeshLod>& lods);
+    static void vertexLayout();
+    static PackedVertex packVertex(const Vertex& vertex, const PositionQuantization& quantization);
 
-    // initializes all the buffer objects/arrays
-    void setupMesh();
+    static unsigned int textureSetID(const vector<TextureBinding>& slots);
 };
 #endif
\ No newline at end of file
@@ -1,45 +1,37 @@
 #include "model.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include "../../stb_image.h"
+#include "GLState.hpp"
+#include "MeshOptimizer.hpp"
+#include "TextureRegistry.hpp"
+#include <cfloat>
+#include <chrono>
 
-unsigned int Model::TextureFromFile(const char* path, const string& directory, bool gamma)
+const unsigned int Model::IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+// the texture types a material is searched for, in the order the shaders name them.
+// texture_<type>N is the sampler, N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER
+struct MaterialTextureType {
+    aiTextureType type;
+    const char* name;
+    unsigned int slot;
+};
+
+static const MaterialTextureType MATERIAL_TEXTURE_TYPES[] = {
+    { aiTextureType_DIFFUSE, "texture_diffuse", SLOT_DIFFUSE },
+    { aiTextureType_SPECULAR, "texture_specular", SLOT_SPECULAR },
+    { aiTextureType_HEIGHT, "texture_normal", SLOT_NORMAL },
+    { aiTextureType_DISPLACEMENT, "texture_height", SLOT_HEIGHT },
+    { aiTextureType_SHININESS, "texture_roughness", SLOT_ROUGHNESS },
+    { aiTextureType_AMBIENT, "texture_ao", SLOT_AO },
+};
+
+unsigned int Model::TextureFromFile(const char* path, const string& directory, TextureCache::Kind kind, bool gamma, const void* owner)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format{};
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureRegistry::Acquire(filename.c_str(), kind, owner);
 }
 
 Model::Model(string const& path, bool gamma) : gammaCorrection(gamma)
@@ -47,38 +39,113 @@ Model::Model(string const& path, bool gamma) : gammaCorrection(gamma)
     loadModel(path);
 }
 
-void Model::Draw(unsigned int shader)
+Model::~Model()
 {
-    for (unsigned int i = 0; i < meshes.size(); i++)
+    for (const Texture& texture : textures_loaded)
+        TextureRegistry::Release(texture.id);
+    for (const Mesh& mesh : meshes)
+        mesh.arena->Free(mesh.geometry);
+}
+
+void Model::loadModel(string const& path)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // retrieve the directory path of the filepath
+    directory = path.substr(0, path.find_last_of('/'));
+
+    uint64_t key = MeshCache::Enabled() ? MeshCache::Key(path, IMPORT_FLAGS) : 0;
+    bool cached = key != 0 && loadCached(key);
+    if (!cached && !importModel(path, key))
+        return;
+
+    computeBounds();
+
+    MeshCache::RecordLoad(path, cached, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+bool Model::loadCached(uint64_t key)
+{
+    MeshCache cache;
+    if (!cache.Open(key))
+        return false;
+
+    // the mapped blobs go to the arena as they are, only the textures are resolved again
+    quantization = cache.Quantization();
+    for (const MeshCache::Entry& entry : cache.Entries())
     {
-        meshes[i].Draw(shader);
+        vector<Texture> textures;
+        vector<TextureBinding> textureSlots;
+        acquireTextures(entry.textures, textures, textureSlots);
+        meshes.push_back(Mesh(entry.geometry, textures, textureSlots, quantization, entry.bounds, entry.sphere));
     }
+    return true;
 }
 
-void Model::loadModel(string const& path)
+bool Model::importModel(string const& path, uint64_t key)
 {
     // read file via ASSIMP
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
     // check for errors
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
     {
         cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-        return;
+        return false;
     }
     else
     {
         cout << "SUCCES" << endl;
     }
 
-    // retrieve the directory path of the filepath
-    directory = path.substr(0, path.find_last_of('/'));
+    computeQuantization(scene);
 
     // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
+    MeshCache::Writer writer(quantization);
+    processNode(scene->mRootNode, scene, key != 0 ? &writer : nullptr);
+
+    if (key != 0 && !writer.Save(key))
+        cout << "WARNING::MESH_CACHE::WRITE_FAILED: " << path << endl;
+    return true;
+}
+
+void Model::computeBounds()
+{
+    for (const Mesh& mesh : meshes)
+        bounds.Expand(mesh.bounds);
+    if (!bounds.IsValid())
+        return;
+
+    sphere.center = bounds.Center();
+    sphere.radius = 0.0f;
+    for (const Mesh& mesh : meshes)
+        sphere.radius = std::max(sphere.radius, glm::length(mesh.sphere.center - sphere.center) + mesh.sphere.radius);
+}
+
+void Model::computeQuantization(const aiScene* scene)
+{
+    glm::vec3 minimum(FLT_MAX), maximum(-FLT_MAX);
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        const aiMesh* mesh = scene->mMeshes[m];
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            glm::vec3 position(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+            minimum = glm::min(minimum, position);
+            maximum = glm::max(maximum, position);
+        }
+    }
+    if (minimum.x > maximum.x)
+        return;
+
+    // a cube rather than the box, a uniform scale keeps the normal matrix of the folded transform valid
+    glm::vec3 extent = maximum - minimum;
+    float size = std::max(extent.x, std::max(extent.y, extent.z));
+    quantization.origin = minimum;
+    quantization.size = size > 0.0f ? size : 1.0f;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+void Model::processNode(aiNode* node, const aiScene* scene, MeshCache::Writer* writer)
 {
     // process each mesh located at the current node
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -86,22 +153,25 @@ void Model::processNode(aiNode* node, const aiScene* scene)
         // the node object only contains indices to index the actual objects in the scene. 
         // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        meshes.push_back(processMesh(mesh, scene, writer));
     }
     // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, writer);
     }
 
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene, MeshCache::Writer* writer)
 {
     // data to fill
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
+    vector<TextureBinding> textureSlots;
+    AABB bounds;
+    BoundingSphere sphere;
 
     // walk through each of the mesh's vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -113,6 +183,7 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
         vector.y = mesh->mVertices[i].y;
         vector.z = mesh->mVertices[i].z;
         vertex.Position = vector;
+        bounds.Expand(vector);
         // normals
         if (mesh->HasNormals())
         {
@@ -146,6 +217,13 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 
         vertices.push_back(vertex);
     }
+    // the sphere is centered on the box and reaches the furthest vertex, tighter than the box's half diagonal
+    if (bounds.IsValid())
+    {
+        sphere.center = bounds.Center();
+        for (const Vertex& vertex : vertices)
+            sphere.radius = std::max(sphere.radius, glm::length(vertex.Position - sphere.center));
+    }
     // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
     for (unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
@@ -154,65 +232,76 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
         for (unsigned int j = 0; j < face.mNumIndices; j++)
             indices.push_back(face.mIndices[j]);
     }
+    // join the per-face vertices and reorder for the vertex cache, overdraw and fetches before they're packed
+    MeshOptimizer::Optimize(vertices, indices);
     // process materials
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-    // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-    // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-    // Same applies to other texture as the following list summarizes:
-    // diffuse: texture_diffuseN
-    // specular: texture_specularN
-    // normal: texture_normalN
-
-    // 1. diffuse maps
-    vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-    // 2. specular maps
-    vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-    // 3. normal maps
-    std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-    // 4. height maps
-    std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_DISPLACEMENT, "texture_height");
-    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-    // 5. roughness maps
-    std::vector<Texture> roughMaps = loadMaterialTextures(material, aiTextureType_SHININESS, "texture_roughness");
-    textures.insert(textures.end(), roughMaps.begin(), roughMaps.end());
-    // 6. ao maps
-    std::vector<Texture> aoMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_ao");
-    textures.insert(textures.end(), aoMaps.begin(), aoMaps.end());
+    vector<MeshCache::TextureReference> references = materialTextures(scene->mMaterials[mesh->mMaterialIndex]);
+    acquireTextures(references, textures, textureSlots);
+
+    // pack once, the same geometry is uploaded and written to the cache
+    vector<PackedVertex> packed;
+    vector<unsigned char> indexData;
+    MeshGeometry geometry = Mesh::BuildGeometry(vertices, indices, quantization, packed, indexData);
+    if (writer)
+        writer->Add(geometry, bounds, sphere, references);
 
     // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+    return Mesh(geometry, textures, textureSlots, quantization, bounds, sphere);
 }
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+vector<MeshCache::TextureReference> Model::materialTextures(aiMaterial* mat)
 {
-    vector<Texture> textures;
-    for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+    vector<MeshCache::TextureReference> references;
+    for (const MaterialTextureType& type : MATERIAL_TEXTURE_TYPES)
     {
-        aiString str;
-        mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++)
+        for (unsigned int i = 0; i < mat->GetTextureCount(type.type); i++)
         {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
+            aiString str;
+            mat->GetTexture(type.type, i, &str);
+            MeshCache::TextureReference reference;
+            reference.type = type.name;
+            reference.path = str.C_Str();
+            references.push_back(reference);
         }
-        if (!skip)
-        {   // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+    }
+    return references;
+}
+
+void Model::acquireTextures(const vector<MeshCache::TextureReference>& references, vector<Texture>& textures, vector<TextureBinding>& slots)
+{
+    for (const MeshCache::TextureReference& reference : references)
+    {
+        // the registry hands out the texture other materials and models already loaded from this file
+        Texture texture;
+        texture.id = TextureFromFile(reference.path.c_str(), this->directory, textureKind(reference.type), false, this);
+        texture.type = reference.type;
+        texture.path = reference.path;
+        textures.push_back(texture);
+        textures_loaded.push_back(texture);  // every acquired reference, released when the model is destroyed
+
+        // the first texture of a type gets its slot
+        bool first = true;
+        for (size_t i = 0; i + 1 < textures.size(); i++)
+            first = first && textures[i].type != reference.type;
+        if (!first)
+            continue;
+        for (const MaterialTextureType& type : MATERIAL_TEXTURE_TYPES)
+        {
+            if (reference.type != type.name)
+                continue;
+            TextureBinding binding;
+            binding.unit = type.slot;
+            binding.id = texture.id;
+            slots.push_back(binding);
         }
     }
-    return textures;
+}
+
+TextureCache::Kind Model::textureKind(const string& typeName)
+{
+    if (typeName == "texture_normal")
+        return TextureCache::NORMAL;
+    if (typeName == "texture_height" || typeName == "texture_roughness" || typeName == "texture_ao")
+        return TextureCache::MASK;
+    return TextureCache::COLOR;
 }
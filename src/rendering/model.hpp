@@ -10,6 +10,8 @@
 #include <assimp/postprocess.h>
 
 #include "mesh.hpp"
+#include "MeshCache.hpp"
+#include "TextureCache.hpp"
 
 #include <string>
 #include <fstream>
@@ -23,28 +25,49 @@ class Model
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// every texture this model acquired from the TextureRegistry, one entry per reference
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
-    static unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+    // cube around all meshes, their positions are quantized into it
+    PositionQuantization quantization;
+    // union of the mesh bounds, the sphere encloses all mesh spheres
+    AABB bounds;
+    BoundingSphere sphere;
+    static unsigned int TextureFromFile(const char* path, const string& directory, TextureCache::Kind kind = TextureCache::COLOR, bool gamma = false, const void* owner = nullptr);
 
     // constructor, expects a filepath to a 3D model.
     Model(string const& path, bool gamma = false);
+    ~Model();
 
-    // draws the model, and thus all its meshes
-    void Draw(unsigned int shader);
+    // the textures are released once, by the destructor
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
 
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // the cache key includes them, changing them imports every model again
+    static const unsigned int IMPORT_FLAGS;
+
+    // loads the model from the mesh cache when it holds it, otherwise with ASSIMP, and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path);
+    // false when the cache has no file for key, the model is imported then
+    bool loadCached(uint64_t key);
+    // key 0 imports without writing a cache file
+    bool importModel(string const& path, uint64_t key);
+    void computeQuantization(const aiScene* scene);
+    void computeBounds();
     
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    // every mesh also goes to writer, when there is one
+    void processNode(aiNode* node, const aiScene* scene, MeshCache::Writer* writer);
+    Mesh processMesh(aiMesh* mesh, const aiScene* scene, MeshCache::Writer* writer);
     
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName);
+    // the textures of a material in slot order, as the cache stores them
+    static vector<MeshCache::TextureReference> materialTextures(aiMaterial* mat);
+    // acquires the textures, the registry only loads the ones nothing has loaded yet. The first texture of a type is
+    // bound to its fixed slot, the shaders only sample texture_<type>1
+    void acquireTextures(const vector<MeshCache::TextureReference>& references, vector<Texture>& textures, vector<TextureBinding>& slots);
+    // normal maps keep two channels and the single value maps one, everything else is color
+    static TextureCache::Kind textureKind(const string& typeName);
 };
 #endif
\ No newline at end of file